@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include "GenericOutput.h"
+#include "FastOutput.h"
+
+/*
+ * CPU cycles per on()/off() pair: digitalWrite(), GenericOutput and FastOutput.
+ * Connect nothing (or a scope) to the pins below.
+ */
+
+#define DIGITAL_PIN 12
+#define GENERIC_PIN 13
+#define FAST_PIN 14
+#define ROUNDS 1000
+
+GenericOutput generic(GENERIC_PIN, HIGH);
+FastOutput<FAST_PIN, HIGH> fast;
+
+template<typename F>
+uint32_t measure(F fn) {
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        fn();
+    }
+    return (ESP.getCycleCount() - start) / ROUNDS;
+}
+
+void setup() {
+    Serial.begin(115200);
+    pinMode(DIGITAL_PIN, OUTPUT);
+    fast.begin();
+    // let the deferred begin() of GenericOutput run
+    GPIO_Scheduler.run();
+
+    uint32_t empty = measure([]() {
+        __asm__ __volatile__("nop");
+    });
+    uint32_t digital = measure([]() {
+        digitalWrite(DIGITAL_PIN, HIGH);
+        digitalWrite(DIGITAL_PIN, LOW);
+    });
+    uint32_t generic_ = measure([]() {
+        generic.on();
+        generic.off();
+    });
+    uint32_t fast_ = measure([]() {
+        fast.on();
+        fast.off();
+    });
+
+    Serial.printf("CPU %u MHz, cycles per on+off (loop overhead %u removed)\n", ESP.getCpuFreqMHz(), empty);
+    Serial.printf("digitalWrite:  %u\n", digital - empty);
+    Serial.printf("GenericOutput: %u\n", generic_ - empty);
+    Serial.printf("FastOutput:    %u\n", fast_ - empty);
+    // the state changes of GenericOutput go through the scheduler (callbacks, last state)
+    GPIO_Scheduler.run();
+}
+
+void loop() {
+#ifdef ESP32
+    GPIO_Scheduler.run();
+#endif
+}
@@ -0,0 +1,45 @@
+#include <Arduino.h>
+#include "PCF8574_library.h"    // https://github.com/nht173/PCF8574_library.git
+#include "MatrixKeypad.h"
+
+#define INT_PIN 16
+
+/* 4x4 keypad: rows on P0..P3, columns on P4..P7 of the expander, INT to the board */
+PCF8574 pcf(0x20);
+
+const uint8_t rowPins[] = {0, 1, 2, 3};
+const uint8_t colPins[] = {4, 5, 6, 7};
+const char keys[4][4] = {
+    {'1', '2', '3', 'A'},
+    {'4', '5', '6', 'B'},
+    {'7', '8', '9', 'C'},
+    {'*', '0', '#', 'D'},
+};
+
+MatrixKeypad keypad(pcf, rowPins, 4, colPins, 4);
+
+
+void setup()
+{
+    Serial.begin(115200);
+    pcf.begin();
+
+    for (uint8_t r = 0; r < 4; r++) {
+        for (uint8_t c = 0; c < 4; c++) {
+            char key = keys[r][c];
+            keypad.key(r, c).onClick([key]() { Serial.printf("%c\n", key); });
+            keypad.key(r, c).onDoubleClick([key]() { Serial.printf("%c double\n", key); });
+        }
+    }
+    keypad.key(3, 0).onPressHold(2000, []() { Serial.println("* held, clear"); });
+
+    // no scan while every key is released, the INT line wakes the keypad
+    keypad.setInterruptPin(INT_PIN);
+    keypad.begin();
+}
+
+void loop()
+{
+    // expander scans and key callbacks run here
+    GPIO_Scheduler.run();
+}
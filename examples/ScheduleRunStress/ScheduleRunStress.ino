@@ -0,0 +1,78 @@
+#include <Arduino.h>
+#include "ScheduleRun.h"
+
+/*
+ * Stress test for the ScheduleRun ring.
+ * Several FreeRTOS tasks and a periodic esp_timer push callbacks at full speed,
+ * loop() is the single consumer. Every pushed callback must run exactly once
+ * and callbacks from the same producer must run in order.
+ */
+
+#if !defined(ESP32)
+#error "This example needs FreeRTOS tasks (ESP32)"
+#endif
+
+#define PRODUCERS 4
+#define PUSHES_PER_PRODUCER 100000
+
+ScheduleRun scheduler;
+
+volatile uint32_t pushed[PRODUCERS + 1];
+uint32_t executed[PRODUCERS + 1];
+uint32_t lastSeq[PRODUCERS + 1];
+uint32_t orderErrors = 0;
+uint32_t timerPushes = 0;
+
+void consume(uint8_t id, uint32_t seq) {
+    if (executed[id] > 0 && seq <= lastSeq[id]) orderErrors++;
+    lastSeq[id] = seq;
+    executed[id]++;
+}
+
+void producerTask(void *arg) {
+    auto id = (uint8_t) (uintptr_t) arg;
+    for (uint32_t seq = 0; seq < PUSHES_PER_PRODUCER; seq++) {
+        while (!scheduler.addSchedule([id, seq]() { consume(id, seq); })) {
+            taskYIELD();
+        }
+        pushed[id]++;
+    }
+    vTaskDelete(nullptr);
+}
+
+void timerProducer(void *) {
+    uint32_t seq = timerPushes;
+    if (scheduler.addSchedule([seq]() { consume(PRODUCERS, seq); })) {
+        pushed[PRODUCERS]++;
+        timerPushes++;
+    }
+}
+
+void setup() {
+    Serial.begin(115200);
+    for (uint8_t i = 0; i < PRODUCERS; i++) {
+        xTaskCreatePinnedToCore(producerTask, "producer", 4096, (void *) (uintptr_t) i, 1, nullptr, i % 2);
+    }
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t args = {
+        .callback = timerProducer,
+        .arg = nullptr,
+        .name = "producer",
+    };
+    esp_timer_create(&args, &timer);
+    esp_timer_start_periodic(timer, 100);
+}
+
+void loop() {
+    scheduler.run();
+    static uint32_t lastPrint = 0;
+    if (millis() - lastPrint >= 1000) {
+        lastPrint = millis();
+        uint32_t totalPushed = 0, totalExecuted = 0;
+        for (uint8_t i = 0; i <= PRODUCERS; i++) {
+            totalPushed += pushed[i];
+            totalExecuted += executed[i];
+        }
+        Serial.printf("pushed: %u, executed: %u, order errors: %u\n", totalPushed, totalExecuted, orderErrors);
+    }
+}
@@ -0,0 +1,100 @@
+#include <Arduino.h>
+#include <algorithm>
+#include "GenericOutput.h"
+
+/*
+ * Auto-off edge jitter of GenericOutput, esp_timer task vs ISR dispatch of the timer wheel.
+ * Wire OUT_PIN to EDGE_PIN. A busy esp_timer callback (LOAD_US every LOAD_PERIOD_US) stands for
+ * the other users of the esp_timer task (WiFi, BLE, other libraries).
+ *
+ * The wheel driver is started for the millisecond boundary of the next due tick, so every expiry
+ * happens at the same phase of the millisecond: the spread of the edge phase is the dispatch latency. Build with -DDEVLIB_TIMER_ISR (and an IDF
+ * config with CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) to measure both methods in one run.
+ */
+
+#if !defined(ESP32)
+#error "This example measures the esp_timer dispatch methods (ESP32)"
+#endif
+
+#define OUT_PIN 25
+#define EDGE_PIN 26
+#define PULSES 200
+#define PULSE_MS 10
+#define LOAD_US 300
+#define LOAD_PERIOD_US 3100
+
+GenericOutput out(OUT_PIN, HIGH, stdGenericOutput::START_UP_NONE, PULSE_MS);
+
+volatile uint32_t edges[PULSES];
+volatile uint32_t edgeCount = 0;
+
+IRAM_ATTR void onEdge() {
+    if (edgeCount < PULSES) edges[edgeCount++] = micros();
+}
+
+void busyLoad(void *) {
+    uint32_t start = micros();
+    while (micros() - start < LOAD_US) {}
+}
+
+/* latency of every edge from the earliest phase: cut the circle of phases at the largest gap */
+void report(const char *name) {
+    static uint32_t phase[PULSES];
+    uint32_t n = edgeCount;
+    for (uint32_t i = 0; i < n; i++) phase[i] = edges[i] % (DEVLIB_TIMER_TICK_MS * 1000);
+    std::sort(phase, phase + n);
+    uint32_t first = 0, gap = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t next = i + 1 < n ? phase[i + 1] : phase[0] + DEVLIB_TIMER_TICK_MS * 1000;
+        if (next - phase[i] > gap) {
+            gap = next - phase[i];
+            first = (i + 1) % n;
+        }
+    }
+    uint32_t maxUs = 0, total = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t latency = (phase[i] + DEVLIB_TIMER_TICK_MS * 1000 - phase[first]) % (DEVLIB_TIMER_TICK_MS * 1000);
+        total += latency;
+        if (latency > maxUs) maxUs = latency;
+    }
+    Serial.printf("%-6s edges: %u, jitter avg: %u us, max: %u us\n", name, n, n ? total / n : 0, maxUs);
+}
+
+void measure(const char *name) {
+    edgeCount = 0;
+    for (uint32_t i = 0; i < PULSES; i++) {
+        out.on();
+        delay(PULSE_MS + 5);
+        GPIO_Scheduler.run();
+    }
+    report(name);
+}
+
+void setup() {
+    Serial.begin(115200);
+    out.begin();
+    pinMode(EDGE_PIN, INPUT);
+    attachInterrupt(EDGE_PIN, onEdge, FALLING);
+
+    esp_timer_handle_t load;
+    esp_timer_create_args_t args = {
+        .callback = busyLoad,
+        .arg = nullptr,
+        .name = "load",
+    };
+    esp_timer_create(&args, &load);
+    esp_timer_start_periodic(load, LOAD_PERIOD_US);
+
+    GPIO_Timer.setIsrDispatch(false);
+    measure("task");
+    if (GPIO_Timer.setIsrDispatch(true)) {
+        measure("isr");
+    } else {
+        Serial.println("Built without DEVLIB_TIMER_ISR, no ISR measurement");
+    }
+    esp_timer_stop(load);
+}
+
+void loop() {
+    GPIO_Scheduler.run();
+}
@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include "GPIO_helper.h"
+
+/*
+ * Arm/cancel throughput of the shared timer wheel (GPIO_Timer).
+ * Arms TIMERS timers with spread timeouts, cancels them all and prints the average cost per operation.
+ */
+
+#if defined(ESP32)
+#define TIMERS 10000
+#else
+#define TIMERS 2000
+#endif
+#define ROUNDS 10
+#define CHUNK 500
+
+timer_node_t *chunks[TIMERS / CHUNK];
+volatile uint32_t fired = 0;
+
+void onTimer(void *) {
+    fired++;
+}
+
+timer_node_t &node(uint32_t i) {
+    return chunks[i / CHUNK][i % CHUNK];
+}
+
+void setup() {
+    Serial.begin(115200);
+    for (auto &chunk: chunks) {
+        chunk = new timer_node_t[CHUNK];
+    }
+    for (uint32_t i = 0; i < TIMERS; i++) {
+        node(i).callback = onTimer;
+    }
+
+    uint32_t armTime = 0, cancelTime = 0;
+    for (uint8_t r = 0; r < ROUNDS; r++) {
+        uint32_t start = micros();
+        for (uint32_t i = 0; i < TIMERS; i++) {
+            GPIO_Timer.arm(&node(i), 1000 + (i * 7919) % 600000);
+        }
+        armTime += micros() - start;
+        start = micros();
+        for (uint32_t i = 0; i < TIMERS; i++) {
+            GPIO_Timer.cancel(&node(i));
+        }
+        cancelTime += micros() - start;
+    }
+    Serial.printf("%u timers, %u rounds\n", TIMERS, ROUNDS);
+    Serial.printf("arm: %.3f us/op, cancel: %.3f us/op\n",
+                  (float) armTime / (TIMERS * ROUNDS), (float) cancelTime / (TIMERS * ROUNDS));
+
+    // expiry check: 1000 timers spread over one second
+    for (uint32_t i = 0; i < 1000 && i < TIMERS; i++) {
+        GPIO_Timer.arm(&node(i), i + 1);
+    }
+}
+
+void loop() {
+    static uint32_t lastPrint = 0;
+    if (millis() - lastPrint >= 1000) {
+        lastPrint = millis();
+        Serial.printf("fired: %u, armed: %u\n", fired, GPIO_Timer.count());
+    }
+}
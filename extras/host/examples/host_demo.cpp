@@ -0,0 +1,68 @@
+/*
+ * PCF_IO on the host: a button on a simulated PCF8574 toggles two LEDs.
+ *
+ * Build:
+ *   cmake -S extras/host -B build-host && cmake --build build-host
+ *   ./build-host/host_demo
+ */
+#include <Arduino.h>
+#include <PCF8574.h>
+#include "GenericOutput.h"
+#include "GenericButton.h"
+#include "DevLibSim.h"
+
+#define ADDR 0x38
+#define INT_PIN 16
+#define LED1_PIN LED_BUILTIN
+#define LED2_PIN 0
+#define BUTTON_PIN 1
+
+PCF8574 pcf(ADDR);
+
+GenericOutput led1(LED1_PIN, LOW);
+GenericOutput led2(pcf, LED2_PIN, LOW);
+GenericButton button(pcf, BUTTON_PIN, INPUT, LOW);
+
+
+static void click(uint32_t holdMs) {
+    pcf.setInput(BUTTON_PIN, LOW);
+    DevLibSim::advance(holdMs);
+    pcf.setInput(BUTTON_PIN, HIGH);
+}
+
+int main() {
+    DevLibSim::onPinChange([](uint8_t pin, bool level, uint64_t us) {
+        if (pin == LED1_PIN) Serial.printf("%8.3f ms  led1 pin %s\n", us / 1000.0, level ? "HIGH" : "LOW");
+    });
+
+    Serial.begin(115200);
+    pcf.begin();
+    pinMode(INT_PIN, INPUT_PULLUP);
+    pcf.setInterruptPin(INT_PIN);
+    GenericInput::attachInterrupt(&pcf, INT_PIN);
+
+    led1.begin();
+    led2.begin();
+
+    button.onPress([]() {
+        led1.toggle();
+        led2.toggle();
+    });
+    button.onDoubleClick([]() {
+        Serial.printf("%8.3f ms  double click\n", millis() * 1.0);
+    });
+
+    DevLibSim::advance(1000);
+    click(80);
+    DevLibSim::advance(1000);
+    click(60);
+    DevLibSim::advance(100);
+    click(60);
+    DevLibSim::advance(1000);
+
+    Serial.printf("led1 %d, led2 %d (PCF latch 0x%02x)\n", led1.getState(), led2.getState(), pcf.getLatch());
+    pcf_port_stats_t stats = PCFPort::getTotalStats();
+    Serial.printf("I2C: %u writes, %u reads\n", (unsigned) Wire.getWriteCount(), (unsigned) Wire.getReadCount());
+    Serial.printf("PCF pin writes %u, port transactions %u\n", (unsigned) stats.writes, (unsigned) stats.transactions);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * TimerWheel cost on the host: 10k timers armed, re-armed and cancelled, then 10k expiries
+ * spread over ten seconds.
+ *
+ *   ./build-host/timer_bench [rounds]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include "GPIO_helper.h"
+#include "DevLibSim.h"
+
+#define TIMERS 10000
+
+static timer_node_t nodes[TIMERS];
+static uint32_t timeouts[TIMERS];
+static uint32_t expired = 0;
+
+static void onExpire(void *) {
+    expired++;
+}
+
+static double nsPerOp(std::chrono::steady_clock::time_point start, uint32_t ops) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100;
+    DevLibSim::reset();
+    std::mt19937 rng(1);
+    for (uint32_t i = 0; i < TIMERS; i++) {
+        nodes[i].callback = onExpire;
+        // mostly debounce and click timeouts, some long auto-off ones on the upper levels
+        timeouts[i] = rng() % 8 ? rng() % 1000 : rng() % 3600000;
+    }
+
+    double arm = 0, rearm = 0, cancel = 0;
+    for (uint32_t round = 0; round < rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < TIMERS; i++) GPIO_Timer.arm(&nodes[i], timeouts[i]);
+        arm += nsPerOp(start, TIMERS);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < TIMERS; i++) GPIO_Timer.arm(&nodes[i], timeouts[TIMERS - 1 - i]);
+        rearm += nsPerOp(start, TIMERS);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < TIMERS; i++) GPIO_Timer.cancel(&nodes[i]);
+        cancel += nsPerOp(start, TIMERS);
+    }
+    printf("arm:    %7.1f ns\n", arm / rounds);
+    printf("re-arm: %7.1f ns\n", rearm / rounds);
+    printf("cancel: %7.1f ns\n", cancel / rounds);
+
+    /* expiries: one tick() per tick, the ticks without an expiry cost next to nothing */
+    for (uint32_t i = 0; i < TIMERS; i++) GPIO_Timer.arm(&nodes[i], 1 + i % 1000 + (i / 1000) * 997);
+    uint32_t ticks = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (GPIO_Timer.count() > 0) {
+        DevLibSim::advanceMicros(DEVLIB_TIMER_TICK_MS * 1000);
+        GPIO_Timer.tick();
+        ticks++;
+    }
+    printf("expire: %7.1f ns per timer (%u expired, %u ticks)\n", nsPerOp(start, TIMERS), expired, ticks);
+    return expired == TIMERS ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// Replay input traces recorded with USE_INPUT_TRACE (GI_Trace) against GenericButton.
+//
+// Every source of the trace gets a button with every event registered; the event sequence
+// and the latency from the decisive edge are printed. Run it over a corpus of traces to
+// check timing changes:
+//
+//   for t in traces/*.trace; do ./build-host/trace_replay -d 50 "$t" > "$t.out"; done
+//
+// Options: -d debounce ms, -c click wait ms, -i idle ms, -h hold ms, -a active level (0/1)
+#include <Arduino.h>
+#include <PCF8574.h>
+#include <map>
+#include <memory>
+#include "GenericButton.h"
+#include "InputTraceReplay.h"
+#include "DevLibSim.h"
+
+/* board pins wired to the INT line of the simulated expanders */
+#define PCF_INT_PIN(index) (DEVLIB_HOST_PINS - 1 - (index))
+#define PCF_ADDRESS(index) (0x20 + (index))
+
+static std::unique_ptr<GenericButton> makeButton(std::unique_ptr<GenericButton> button,
+                                                 uint32_t clickMs, uint32_t idleMs, uint32_t holdMs) {
+    button->setClickWaitTime(clickMs);
+    button->setIdleTime(idleMs);
+    button->setHoldTime(holdMs);
+    button->onPress([]() {});
+    button->onRelease([]() {});
+    button->onClick([]() {});
+    button->onDoubleClick([]() {});
+    button->onLongClick([]() {});
+    button->onIdle([]() {});
+    for (uint8_t count = 3; count <= 5; count++) {
+        button->onClickCount(count, []() {});
+    }
+    return button;
+}
+
+int main(int argc, char **argv) {
+    uint32_t debounceMs = 50, clickMs = 300, idleMs = 500, holdMs = 3000;
+    bool activeState = LOW;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] != 0 && i + 1 < argc) {
+            uint32_t value = strtoul(argv[i + 1], nullptr, 10);
+            switch (argv[i++][1]) {
+                case 'd': debounceMs = value; break;
+                case 'c': clickMs = value; break;
+                case 'i': idleMs = value; break;
+                case 'h': holdMs = value; break;
+                case 'a': activeState = value != 0; break;
+                default: break;
+            }
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        printf("usage: %s [-d debounce] [-c click] [-i idle] [-h hold] [-a active] trace\n", argv[0]);
+        return 2;
+    }
+
+    InputTraceReplay replay;
+    if (!replay.loadFile(path)) return 1;
+
+    if (replay.dropped()) printf("warning: %u edges were dropped while recording\n", replay.dropped());
+
+    /* one button per source, expanders are created in index order so they match the trace */
+    uint8_t mode = activeState == LOW ? INPUT_PULLUP : INPUT;
+    std::map<uint8_t, std::unique_ptr<PCF8574>> expanders;
+    std::vector<std::unique_ptr<GenericButton>> buttons;
+    for (uint8_t source: replay.sources()) {
+        if (source < INPUT_TRACE_PCF_SOURCE) {
+            buttons.push_back(makeButton(std::unique_ptr<GenericButton>(
+                    new GenericButton(source, mode, activeState, debounceMs)), clickMs, idleMs, holdMs));
+            continue;
+        }
+        uint8_t index = (source - INPUT_TRACE_PCF_SOURCE) / PCF_PORT_PINS;
+        if (index >= PCF_MAX_PORTS) continue;
+        for (uint8_t i = expanders.size(); i <= index; i++) {
+            auto *pcf = new PCF8574(PCF_ADDRESS(i));
+            expanders[i].reset(pcf);
+            pcf->setInterruptPin(PCF_INT_PIN(i));
+            GenericInput::attachInterrupt(pcf, PCF_INT_PIN(i));
+            replay.bindPCF(i, *pcf);
+        }
+        buttons.push_back(makeButton(std::unique_ptr<GenericButton>(
+                new GenericButton(*expanders[index], (source - INPUT_TRACE_PCF_SOURCE) % PCF_PORT_PINS,
+                                  INPUT, activeState, debounceMs)), clickMs, idleMs, holdMs));
+    }
+
+    // start away from boot time, a press in the first click wait after boot counts as a second click
+    DevLibSim::advance(1000 + clickMs);
+    size_t edges = replay.run(idleMs + holdMs);
+    printf("%zu edges, %zu events\n", edges, replay.results().size());
+    replay.print();
+    return 0;
+}
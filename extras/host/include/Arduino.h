@@ -0,0 +1,349 @@
+#ifndef DEVLIB_HOST_ARDUINO_H
+#define DEVLIB_HOST_ARDUINO_H
+
+/*
+ * Host stand-in for the Arduino core: enough of the API used by src/ to build and run
+ * the library on a workstation. Pins, clock and buses are simulated, see DevLibSim.h.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cctype>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#ifndef DEVLIB_HOST
+#define DEVLIB_HOST
+#endif
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define OUTPUT_OPEN_DRAIN 0x13
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 2
+#endif
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+/* Simulated GPIO count */
+#ifndef DEVLIB_HOST_PINS
+#define DEVLIB_HOST_PINS 64
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+
+/* ================ String ================ */
+
+class String {
+public:
+    String() = default;
+
+    String(const char *str) : _s(str != nullptr ? str : "") {}
+
+    String(const std::string &str) : _s(str) {}
+
+    String(char c) : _s(1, c) {}
+
+    String(unsigned char value, unsigned char base = 10) : String((unsigned long) value, base) {}
+
+    String(int value, unsigned char base = 10) : String((long) value, base) {}
+
+    String(unsigned int value, unsigned char base = 10) : String((unsigned long) value, base) {}
+
+    String(long value, unsigned char base = 10) {
+        if (value < 0 && base == 10) {
+            _s = "-" + _toBase((unsigned long) -value, base);
+        } else {
+            _s = _toBase((unsigned long) value, base);
+        }
+    }
+
+    String(unsigned long value, unsigned char base = 10) : _s(_toBase(value, base)) {}
+
+    String(float value, unsigned char decimals = 2) : String((double) value, decimals) {}
+
+    String(double value, unsigned char decimals = 2) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        _s = buf;
+    }
+
+    const char *c_str() const {
+        return _s.c_str();
+    }
+
+    unsigned int length() const {
+        return (unsigned int) _s.size();
+    }
+
+    bool isEmpty() const {
+        return _s.empty();
+    }
+
+    char charAt(unsigned int index) const {
+        return index < _s.size() ? _s[index] : 0;
+    }
+
+    char operator[](unsigned int index) const {
+        return charAt(index);
+    }
+
+    bool startsWith(const String &prefix) const {
+        return _s.compare(0, prefix._s.size(), prefix._s) == 0;
+    }
+
+    bool endsWith(const String &suffix) const {
+        return _s.size() >= suffix._s.size() &&
+               _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t pos = _s.find(c, from);
+        return pos == std::string::npos ? -1 : (int) pos;
+    }
+
+    int indexOf(const String &str, unsigned int from = 0) const {
+        size_t pos = _s.find(str._s, from);
+        return pos == std::string::npos ? -1 : (int) pos;
+    }
+
+    String substring(unsigned int from) const {
+        return from >= _s.size() ? String() : String(_s.substr(from));
+    }
+
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= _s.size()) return String();
+        return String(_s.substr(from, to - from));
+    }
+
+    void remove(unsigned int index) {
+        if (index < _s.size()) _s.erase(index);
+    }
+
+    void remove(unsigned int index, unsigned int count) {
+        if (index < _s.size()) _s.erase(index, count);
+    }
+
+    void trim() {
+        size_t begin = _s.find_first_not_of(" \t\r\n");
+        size_t end = _s.find_last_not_of(" \t\r\n");
+        _s = begin == std::string::npos ? std::string() : _s.substr(begin, end - begin + 1);
+    }
+
+    void toUpperCase() {
+        for (auto &c: _s) c = (char) toupper((unsigned char) c);
+    }
+
+    void toLowerCase() {
+        for (auto &c: _s) c = (char) tolower((unsigned char) c);
+    }
+
+    long toInt() const {
+        return strtol(_s.c_str(), nullptr, 10);
+    }
+
+    float toFloat() const {
+        return strtof(_s.c_str(), nullptr);
+    }
+
+    bool equals(const String &other) const {
+        return _s == other._s;
+    }
+
+    bool concat(const String &other) {
+        _s += other._s;
+        return true;
+    }
+
+    String &operator+=(const String &other) {
+        _s += other._s;
+        return *this;
+    }
+
+    String &operator+=(const char *other) {
+        _s += other;
+        return *this;
+    }
+
+    String &operator+=(char c) {
+        _s += c;
+        return *this;
+    }
+
+    friend String operator+(const String &a, const String &b) {
+        return String(a._s + b._s);
+    }
+
+    friend String operator+(const String &a, const char *b) {
+        return String(a._s + b);
+    }
+
+    friend String operator+(const char *a, const String &b) {
+        return String(a + b._s);
+    }
+
+    bool operator==(const String &other) const {
+        return _s == other._s;
+    }
+
+    bool operator==(const char *other) const {
+        return _s == other;
+    }
+
+    bool operator!=(const String &other) const {
+        return _s != other._s;
+    }
+
+    bool operator!=(const char *other) const {
+        return _s != other;
+    }
+
+    bool operator<(const String &other) const {
+        return _s < other._s;
+    }
+
+private:
+    std::string _s;
+
+    static std::string _toBase(unsigned long value, unsigned char base) {
+        if (base < 2 || base > 36) base = 10;
+        char buf[sizeof(unsigned long) * 8 + 1];
+        char *p = buf + sizeof(buf) - 1;
+        *p = 0;
+        do {
+            unsigned digit = value % base;
+            *--p = (char) (digit < 10 ? '0' + digit : 'A' + digit - 10);
+            value /= base;
+        } while (value);
+        return p;
+    }
+};
+
+
+/* ================ Serial ================ */
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+
+    size_t print(const String &s) {
+        return _write(s.c_str());
+    }
+
+    size_t print(const char *s) {
+        return _write(s);
+    }
+
+    size_t print(char c) {
+        char s[2] = {c, 0};
+        return _write(s);
+    }
+
+    size_t print(long value) {
+        return print(String(value));
+    }
+
+    size_t print(int value) {
+        return print(String(value));
+    }
+
+    size_t print(unsigned long value) {
+        return print(String(value));
+    }
+
+    size_t print(unsigned int value) {
+        return print(String(value));
+    }
+
+    size_t print(double value, int decimals = 2) {
+        return print(String(value, (unsigned char) decimals));
+    }
+
+    template<typename T>
+    size_t println(const T &value) {
+        return print(value) + _write("\n");
+    }
+
+    size_t println() {
+        return _write("\n");
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * @brief Mute the output, e.g. while profiling
+     */
+    void setEnabled(bool enabled) {
+        _enabled = enabled;
+    }
+
+    explicit operator bool() const {
+        return true;
+    }
+
+private:
+    bool _enabled = true;
+
+    size_t _write(const char *s);
+};
+
+extern HardwareSerial Serial;
+
+
+/* ================ Core ================ */
+
+uint32_t millis();
+
+uint32_t micros();
+
+void delay(uint32_t ms);
+
+void delayMicroseconds(uint32_t us);
+
+inline void yield() {}
+
+inline void noInterrupts() {}
+
+inline void interrupts() {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+void digitalWrite(uint8_t pin, uint8_t value);
+
+int digitalRead(uint8_t pin);
+
+inline int digitalPinToInterrupt(uint8_t pin) {
+    return pin < DEVLIB_HOST_PINS ? pin : -1;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+
+void detachInterrupt(uint8_t pin);
+
+template<typename T>
+inline T constrain(T value, T low, T high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+#endif // DEVLIB_HOST_ARDUINO_H
@@ -0,0 +1,84 @@
+#ifndef DEVLIB_HOST_SIM_H
+#define DEVLIB_HOST_SIM_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Control of the simulated board of the host backend.
+ *
+ * Time only moves when the test or benchmark advances it: advance() steps the virtual
+ * monotonic clock one timer tick at a time, runs the GPIO_Timer driver while timers are armed
+ * and drains GPIO_Scheduler after every step, like a sketch loop calling run().
+ *
+ * Inputs are driven with setInput(), which fires the attached interrupt handlers synchronously.
+ */
+namespace DevLibSim {
+
+    /**
+     * @brief Reset the clock and the pins
+     */
+    void reset();
+
+    /**
+     * @brief Advance the virtual clock
+     * @param ms milliseconds
+     */
+    void advance(uint32_t ms);
+
+    /**
+     * @brief Advance the virtual clock without running the timer driver or the scheduler
+     * @param us microseconds
+     */
+    void advanceMicros(uint32_t us);
+
+    /**
+     * @brief Virtual time in microseconds since reset()
+     */
+    uint64_t now();
+
+    /**
+     * @brief Run GPIO_Scheduler until it is empty
+     */
+    void runScheduler();
+
+    /**
+     * @brief Drain GPIO_Scheduler after every clock step (default true)
+     */
+    void setAutoRunScheduler(bool enabled);
+
+    /**
+     * @brief Drive an input pin from outside. Fires the attached interrupt on an edge
+     * @param pin
+     * @param level HIGH or LOW
+     */
+    void setInput(uint8_t pin, bool level);
+
+    /**
+     * @brief Release an input pin, it reads its pull-up/pull-down level again
+     */
+    void releaseInput(uint8_t pin);
+
+    /**
+     * @brief Level of a pin as seen on the board (output latch or input level)
+     */
+    bool getPin(uint8_t pin);
+
+    /**
+     * @brief Mode set by pinMode(), 0 if never set
+     */
+    uint8_t getPinMode(uint8_t pin);
+
+    /**
+     * @brief Number of digitalWrite() calls on a pin since reset()
+     */
+    uint32_t getWriteCount(uint8_t pin);
+
+    /**
+     * @brief Callback on every level change of a pin (outputs and inputs)
+     * @param listener pin, level, time in microseconds
+     */
+    void onPinChange(std::function<void(uint8_t, bool, uint64_t)> listener);
+}
+
+
+#endif // DEVLIB_HOST_SIM_H
@@ -0,0 +1,93 @@
+#ifndef DEVLIB_HOST_ENVFILE_H
+#define DEVLIB_HOST_ENVFILE_H
+
+#include <Arduino.h>
+#include <map>
+
+/**
+ * @brief In-memory ENVFile: key/value store with the API of the board version, nothing is
+ * written to disk. The counters tell how often the library touched the flash.
+ *
+ * Constant-initialized, so global devices may use it from their constructors.
+ */
+class ENVFile {
+public:
+    constexpr explicit ENVFile(const char *path) : _path(path) {}
+
+    bool set(const String &key, const String &value) {
+        _map()[key] = value;
+        _writes++;
+        return true;
+    }
+
+    bool set(const String &key, const char *value) {
+        return set(key, String(value));
+    }
+
+    bool set(const String &key, bool value) {
+        return set(key, String(value ? "1" : "0"));
+    }
+
+    bool set(const String &key, int value) {
+        return set(key, String(value));
+    }
+
+    String get(const String &key, const String &defaultValue = String()) {
+        _reads++;
+        auto it = _map().find(key);
+        return it == _map().end() ? defaultValue : it->second;
+    }
+
+    bool getBool(const String &key, bool defaultValue = false) {
+        _reads++;
+        auto it = _map().find(key);
+        if (it == _map().end()) return defaultValue;
+        return it->second == "1" || it->second == "true";
+    }
+
+    int getInt(const String &key, int defaultValue = 0) {
+        _reads++;
+        auto it = _map().find(key);
+        return it == _map().end() ? defaultValue : (int) it->second.toInt();
+    }
+
+    bool has(const String &key) {
+        return _map().count(key) > 0;
+    }
+
+    bool remove(const String &key) {
+        return _map().erase(key) > 0;
+    }
+
+    void clear() {
+        _map().clear();
+        _writes = 0;
+        _reads = 0;
+    }
+
+    const char *getPath() const {
+        return _path;
+    }
+
+    uint32_t getWriteCount() const {
+        return _writes;
+    }
+
+    uint32_t getReadCount() const {
+        return _reads;
+    }
+
+private:
+    const char *_path;
+    std::map<String, String> *_values = nullptr; // created on first use
+    uint32_t _writes = 0;
+    uint32_t _reads = 0;
+
+    std::map<String, String> &_map() {
+        if (_values == nullptr) _values = new std::map<String, String>();
+        return *_values;
+    }
+};
+
+
+#endif // DEVLIB_HOST_ENVFILE_H
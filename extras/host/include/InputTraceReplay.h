@@ -0,0 +1,106 @@
+#ifndef DEVLIB_HOST_INPUTTRACEREPLAY_H
+#define DEVLIB_HOST_INPUTTRACEREPLAY_H
+
+#include <Arduino.h>
+#include <PCF8574.h>
+#include <vector>
+#include "InputTrace.h"
+#include "PCFPort.h"
+
+struct input_trace_result_t {
+    uint64_t timeUs; // since the start of the replay
+    uint8_t source;
+    uint8_t event;   // input_trace_event_t or generic_button_event_t
+    uint64_t edgeUs; // last edge of the source before the event
+};
+
+/**
+ * @brief Feed a recorded InputTrace into the inputs on virtual time.
+ *
+ * Every edge is applied at its recorded time: on-chip sources with DevLibSim::setInput(),
+ * expander sources on the PCF8574 bound with bindPCF(). The edges go through the interrupt,
+ * the debounce timer and _processHandler() like on the board, but the clock only jumps from
+ * edge to edge, so a trace of minutes replays in milliseconds.
+ *
+ * The events dispatched by the inputs are collected with the latency from the decisive
+ * edge, i.e. the last edge of the same source.
+ *
+ * Example:
+ * @code
+ * GenericButton button(4, INPUT_PULLUP);
+ * button.onDoubleClick([]() {});
+ *
+ * InputTraceReplay replay;
+ * replay.loadFile("double_click.trace");
+ * replay.run();
+ * replay.print();
+ * @endcode
+ */
+class InputTraceReplay {
+public:
+    /**
+     * @brief Expander receiving the edges of its sources
+     * @param index order of the expander in the trace (order of GenericInput::attachInterrupt)
+     */
+    void bindPCF(uint8_t index, PCF8574 &pcf);
+
+    /**
+     * @brief Load a serialized trace
+     * @return false if the header is invalid
+     */
+    bool load(const void *data, size_t length);
+
+    bool loadFile(const char *path);
+
+    /**
+     * @brief Sources with edges in the loaded trace, in ascending order
+     */
+    std::vector<uint8_t> sources() const;
+
+    /**
+     * @brief Edges lost by the recorder of the loaded trace
+     */
+    uint32_t dropped() const;
+
+    /**
+     * @brief Write a recorded trace to a file
+     */
+    static bool saveFile(const char *path, const InputTrace &trace = GI_Trace);
+
+    /**
+     * @brief Replay the trace from the current virtual time
+     * @param tailMs time to run after the last edge, for the click and idle timers
+     * @return edges applied
+     */
+    size_t run(uint32_t tailMs = 2000);
+
+    const std::vector<input_trace_result_t> &results() const {
+        return _results;
+    }
+
+    /**
+     * @brief Print the event sequence with the latencies
+     */
+    void print() const;
+
+    /**
+     * @brief Name of an event
+     */
+    static const char *eventName(uint8_t event);
+
+private:
+    std::vector<uint8_t> _data;
+    PCF8574 *_pcf[PCF_MAX_PORTS] = {};
+    std::vector<input_trace_result_t> _results;
+    uint64_t _startUs = 0;
+    uint64_t _lastEdgeUs[128] = {};
+
+    void _apply(const input_trace_edge_t &edge);
+
+    static void _advanceTo(uint64_t timeUs);
+
+    static void _onEvent(uint8_t source, uint8_t event, uint32_t timeUs, void *arg);
+};
+
+
+#endif // DEVLIB_HOST_INPUTTRACEREPLAY_H
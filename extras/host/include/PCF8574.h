@@ -0,0 +1,95 @@
+#ifndef DEVLIB_HOST_PCF8574_H
+#define DEVLIB_HOST_PCF8574_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+/**
+ * @brief Simulated PCF8574 on the host Wire bus.
+ *
+ * Same calls as the Arduino PCF8574 library used on the boards. The port is quasi-bidirectional:
+ * a pin reads LOW when its latch is LOW or when it is pulled LOW from outside with setInput().
+ * With an INT pin, the board pin is driven LOW on every input change and released by the next
+ * port read, like the open-drain INT line of the chip.
+ */
+class PCF8574 : public SimI2CDevice {
+public:
+    explicit PCF8574(uint8_t address, TwoWire &wire = Wire);
+
+    ~PCF8574() override;
+
+    bool begin() {
+        return true;
+    }
+
+    uint8_t getAddress() const {
+        return _address;
+    }
+
+    void pinMode(uint8_t pin, uint8_t mode);
+
+    /**
+     * @return false if the port write was not acknowledged
+     */
+    bool digitalWrite(uint8_t pin, uint8_t value);
+
+    /**
+     * @brief Write the whole port, bit n is pin n
+     * @return false if the port write was not acknowledged
+     */
+    bool digitalWriteAll(uint8_t value);
+
+    uint8_t digitalRead(uint8_t pin, bool forceReadNow = false);
+
+    uint8_t digitalReadAll();
+
+    /* ================ Simulation ================ */
+
+    /**
+     * @brief Drive an input from outside
+     * @param pin 0..7
+     * @param level LOW pulls the pin down, HIGH releases it
+     */
+    void setInput(uint8_t pin, bool level);
+
+    /**
+     * @brief Board pin wired to INT, it must be an input with pull-up on the board side
+     */
+    void setInterruptPin(uint8_t boardPin) {
+        _intPin = boardPin;
+    }
+
+    /**
+     * @brief Port as seen on the pins
+     */
+    uint8_t getPort() const {
+        return _latch & _external;
+    }
+
+    /**
+     * @brief Latch written by the last port write
+     */
+    uint8_t getLatch() const {
+        return _latch;
+    }
+
+    void onI2CWrite(const uint8_t *data, size_t length) override;
+
+    size_t onI2CRead(uint8_t *data, size_t length) override;
+
+private:
+    TwoWire &_wire;
+    uint8_t _address;
+    uint8_t _latch = 0xFF;    // power-on state, all pins weak high
+    uint8_t _external = 0xFF; // pins pulled low from outside
+    uint8_t _lastRead = 0xFF; // port value at the last read, for INT
+    uint8_t _intPin = UINT8_MAX;
+    bool _intActive = false;
+
+    bool _writePort(uint8_t value);
+
+    void _updateInterrupt();
+};
+
+
+#endif // DEVLIB_HOST_PCF8574_H
@@ -0,0 +1,108 @@
+#ifndef DEVLIB_HOST_WIRE_H
+#define DEVLIB_HOST_WIRE_H
+
+#include <Arduino.h>
+
+/* Devices on the simulated bus */
+#ifndef WIRE_SIM_DEVICES
+#define WIRE_SIM_DEVICES 16
+#endif
+
+#define WIRE_BUFFER_LENGTH 32
+
+/**
+ * @brief Device answering on the simulated I2C bus
+ */
+class SimI2CDevice {
+public:
+    virtual ~SimI2CDevice() = default;
+
+    /**
+     * @brief Bytes of a write transaction
+     */
+    virtual void onI2CWrite(const uint8_t *data, size_t length) = 0;
+
+    /**
+     * @brief Fill a read transaction
+     * @return bytes provided
+     */
+    virtual size_t onI2CRead(uint8_t *data, size_t length) = 0;
+};
+
+/**
+ * @brief Host TwoWire: transactions are routed by address to the attached SimI2CDevice
+ */
+class TwoWire {
+public:
+    bool begin() {
+        return true;
+    }
+
+    bool begin(int, int, uint32_t = 0) {
+        return true;
+    }
+
+    void setClock(uint32_t) {}
+
+    void beginTransmission(uint8_t address);
+
+    size_t write(uint8_t value);
+
+    size_t write(const uint8_t *data, size_t length);
+
+    /**
+     * @return 0 on success, 2 when no device acknowledges the address
+     */
+    uint8_t endTransmission(bool sendStop = true);
+
+    uint8_t requestFrom(uint8_t address, uint8_t length, bool sendStop = true);
+
+    int available();
+
+    int read();
+
+    /**
+     * @brief Attach a simulated device at an address
+     */
+    bool attach(uint8_t address, SimI2CDevice *device);
+
+    void detach(uint8_t address);
+
+    /**
+     * @brief Completed write transactions since start
+     */
+    uint32_t getWriteCount() const {
+        return _writes;
+    }
+
+    /**
+     * @brief Completed read transactions since start
+     */
+    uint32_t getReadCount() const {
+        return _reads;
+    }
+
+private:
+    struct device_t {
+        uint8_t address;
+        SimI2CDevice *device;
+    };
+
+    device_t _devices[WIRE_SIM_DEVICES] = {};
+    uint8_t _deviceCount = 0;
+    uint8_t _address = 0;
+    uint8_t _txBuffer[WIRE_BUFFER_LENGTH] = {};
+    uint8_t _txLength = 0;
+    uint8_t _rxBuffer[WIRE_BUFFER_LENGTH] = {};
+    uint8_t _rxLength = 0;
+    uint8_t _rxIndex = 0;
+    uint32_t _writes = 0;
+    uint32_t _reads = 0;
+
+    SimI2CDevice *_find(uint8_t address) const;
+};
+
+extern TwoWire Wire;
+
+
+#endif // DEVLIB_HOST_WIRE_H
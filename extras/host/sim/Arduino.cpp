@@ -0,0 +1,194 @@
+#include <Arduino.h>
+#include "DevLibSim.h"
+#include "GPIO_helper.h"
+
+HardwareSerial Serial;
+
+struct sim_pin_t {
+    uint8_t mode = 0;
+    bool latch = false;      // output level
+    bool driven = false;     // input driven by setInput()
+    bool input = false;      // level driven on the input
+    uint32_t writes = 0;
+    void (*handler)(void *) = nullptr;
+    void (*plainHandler)() = nullptr;
+    void *arg = nullptr;
+    int irqMode = 0;
+};
+
+static sim_pin_t _pins[DEVLIB_HOST_PINS];
+static uint64_t _nowUs = 0;
+static bool _autoRun = true;
+static std::function<void(uint8_t, bool, uint64_t)> _pinListener;
+
+
+/* ================ Serial ================ */
+
+size_t HardwareSerial::printf(const char *format, ...) {
+    if (!_enabled) return 0;
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n > 0 ? (size_t) n : 0;
+}
+
+size_t HardwareSerial::_write(const char *s) {
+    if (!_enabled) return 0;
+    return fputs(s, stdout) >= 0 ? strlen(s) : 0;
+}
+
+
+/* ================ Core ================ */
+
+uint32_t millis() {
+    return (uint32_t) (_nowUs / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t) _nowUs;
+}
+
+void delay(uint32_t ms) {
+    DevLibSim::advance(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+    DevLibSim::advanceMicros(us);
+}
+
+static bool _level(const sim_pin_t &pin) {
+    if (pin.mode == OUTPUT) return pin.latch;
+    if (pin.mode == OUTPUT_OPEN_DRAIN && !pin.latch) return false;
+    if (pin.driven) return pin.input;
+    return pin.mode == INPUT_PULLUP || pin.mode == OUTPUT_OPEN_DRAIN;
+}
+
+static void _notify(uint8_t pin, bool level) {
+    if (_pinListener) _pinListener(pin, level, _nowUs);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    _pins[pin].mode = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    sim_pin_t &p = _pins[pin];
+    bool before = _level(p);
+    p.latch = value != LOW;
+    p.writes++;
+    if (_level(p) != before) _notify(pin, _level(p));
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= DEVLIB_HOST_PINS) return LOW;
+    return _level(_pins[pin]) ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    _pins[pin].plainHandler = handler;
+    _pins[pin].handler = nullptr;
+    _pins[pin].irqMode = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    _pins[pin].handler = handler;
+    _pins[pin].plainHandler = nullptr;
+    _pins[pin].arg = arg;
+    _pins[pin].irqMode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    _pins[pin].handler = nullptr;
+    _pins[pin].plainHandler = nullptr;
+    _pins[pin].irqMode = 0;
+}
+
+
+/* ================ Simulation ================ */
+
+static void _edge(uint8_t pin, bool before, bool after) {
+    if (before == after) return;
+    _notify(pin, after);
+    sim_pin_t &p = _pins[pin];
+    bool fire = p.irqMode == CHANGE || (p.irqMode == RISING && after) || (p.irqMode == FALLING && !after);
+    if (!fire) return;
+    if (p.handler != nullptr) {
+        p.handler(p.arg);
+    } else if (p.plainHandler != nullptr) {
+        p.plainHandler();
+    }
+}
+
+void DevLibSim::reset() {
+    for (auto &pin: _pins) {
+        pin = sim_pin_t();
+    }
+    _nowUs = 0;
+    _autoRun = true;
+    _pinListener = nullptr;
+}
+
+void DevLibSim::advance(uint32_t ms) {
+    // tick() every step: it only does work on the ticks the one-shot driver of GPIO_Timer would wake for
+    for (uint32_t elapsed = 0; elapsed < ms; elapsed += DEVLIB_TIMER_TICK_MS) {
+        _nowUs += DEVLIB_TIMER_TICK_MS * 1000ULL;
+        GPIO_Timer.tick();
+        if (_autoRun) runScheduler();
+    }
+}
+
+void DevLibSim::advanceMicros(uint32_t us) {
+    _nowUs += us;
+}
+
+uint64_t DevLibSim::now() {
+    return _nowUs;
+}
+
+void DevLibSim::runScheduler() {
+    // a run leaves the schedules added meanwhile for the next one, like successive loop() calls
+    for (uint8_t round = 0; round < 64 && !GPIO_Scheduler.run(); round++) {}
+}
+
+void DevLibSim::setAutoRunScheduler(bool enabled) {
+    _autoRun = enabled;
+}
+
+void DevLibSim::setInput(uint8_t pin, bool level) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    sim_pin_t &p = _pins[pin];
+    bool before = _level(p);
+    p.driven = true;
+    p.input = level;
+    _edge(pin, before, _level(p));
+}
+
+void DevLibSim::releaseInput(uint8_t pin) {
+    if (pin >= DEVLIB_HOST_PINS) return;
+    sim_pin_t &p = _pins[pin];
+    bool before = _level(p);
+    p.driven = false;
+    _edge(pin, before, _level(p));
+}
+
+bool DevLibSim::getPin(uint8_t pin) {
+    return pin < DEVLIB_HOST_PINS && _level(_pins[pin]);
+}
+
+uint8_t DevLibSim::getPinMode(uint8_t pin) {
+    return pin < DEVLIB_HOST_PINS ? _pins[pin].mode : 0;
+}
+
+uint32_t DevLibSim::getWriteCount(uint8_t pin) {
+    return pin < DEVLIB_HOST_PINS ? _pins[pin].writes : 0;
+}
+
+void DevLibSim::onPinChange(std::function<void(uint8_t, bool, uint64_t)> listener) {
+    _pinListener = std::move(listener);
+}
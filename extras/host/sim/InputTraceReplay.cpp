@@ -0,0 +1,164 @@
+#include "InputTraceReplay.h"
+#include "DevLibSim.h"
+#include "GPIO_helper.h"
+#include "GenericButton.h"
+
+
+void InputTraceReplay::bindPCF(uint8_t index, PCF8574 &pcf) {
+    if (index < PCF_MAX_PORTS) _pcf[index] = &pcf;
+}
+
+bool InputTraceReplay::load(const void *data, size_t length) {
+    InputTraceReader reader(data, length);
+    if (!reader.isValid()) {
+        Serial.println("[Err][InputTraceReplay] Invalid trace");
+        return false;
+    }
+    auto *bytes = static_cast<const uint8_t *>(data);
+    _data.assign(bytes, bytes + length);
+    return true;
+}
+
+bool InputTraceReplay::loadFile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        Serial.printf("[Err][InputTraceReplay] Failed to open %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[512];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(file);
+    return load(data.data(), data.size());
+}
+
+std::vector<uint8_t> InputTraceReplay::sources() const {
+    bool seen[128] = {};
+    InputTraceReader reader(_data.data(), _data.size());
+    input_trace_edge_t edge{};
+    while (reader.next(edge)) {
+        seen[edge.source] = true;
+    }
+    std::vector<uint8_t> sources;
+    for (uint8_t source = 0; source < 128; source++) {
+        if (seen[source]) sources.push_back(source);
+    }
+    return sources;
+}
+
+uint32_t InputTraceReplay::dropped() const {
+    InputTraceReader reader(_data.data(), _data.size());
+    return reader.isValid() ? reader.header().dropped : 0;
+}
+
+bool InputTraceReplay::saveFile(const char *path, const InputTrace &trace) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        Serial.printf("[Err][InputTraceReplay] Failed to create %s\n", path);
+        return false;
+    }
+    uint8_t buf[512];
+    size_t offset = 0, n;
+    bool ok = true;
+    while (ok && (n = trace.read(offset, buf, sizeof(buf))) > 0) {
+        ok = fwrite(buf, 1, n, file) == n;
+        offset += n;
+    }
+    fclose(file);
+    return ok;
+}
+
+size_t InputTraceReplay::run(uint32_t tailMs) {
+    _results.clear();
+    std::fill(std::begin(_lastEdgeUs), std::end(_lastEdgeUs), 0);
+    _startUs = DevLibSim::now();
+    bool recording = GI_Trace.isRecording();
+    GI_Trace.stop(); // the replayed edges would be recorded again
+    GI_Trace.setEventListener(_onEvent, this);
+
+    size_t edges = 0;
+    InputTraceReader reader(_data.data(), _data.size());
+    input_trace_edge_t edge{};
+    while (reader.next(edge)) {
+        _advanceTo(_startUs + edge.timeUs);
+        _lastEdgeUs[edge.source] = edge.timeUs;
+        _apply(edge);
+        edges++;
+    }
+    DevLibSim::advance(tailMs);
+
+    GI_Trace.setEventListener(nullptr);
+    if (recording) GI_Trace.start();
+    return edges;
+}
+
+void InputTraceReplay::print() const {
+    for (const auto &result: _results) {
+        Serial.printf("%10.3f ms  source %3u  %-13s latency %8.3f ms\n",
+                      result.timeUs / 1000.0, result.source, eventName(result.event),
+                      (result.timeUs - result.edgeUs) / 1000.0);
+    }
+}
+
+const char *InputTraceReplay::eventName(uint8_t event) {
+    switch (event) {
+        case INPUT_TRACE_EVENT_ACTIVE:
+            return "ACTIVE";
+        case INPUT_TRACE_EVENT_INACTIVE:
+            return "INACTIVE";
+        case BUTTON_EVENT_IDLE:
+            return "IDLE";
+        case BUTTON_EVENT_CLICK:
+            return "CLICK";
+        case BUTTON_EVENT_DOUBLE_CLICK:
+            return "DOUBLE_CLICK";
+        case BUTTON_EVENT_LONG_CLICK:
+            return "LONG_CLICK";
+        case BUTTON_EVENT_CLICK_COUNT:
+            return "CLICK_COUNT";
+        case BUTTON_EVENT_PRESS_HOLD:
+            return "PRESS_HOLD";
+        case BUTTON_EVENT_PRESSED:
+            return "PRESSED";
+        case BUTTON_EVENT_RELEASED:
+            return "RELEASED";
+        case BUTTON_EVENT_STATE_CHANGE:
+            return "STATE_CHANGE";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+void InputTraceReplay::_apply(const input_trace_edge_t &edge) {
+    if (edge.source < INPUT_TRACE_PCF_SOURCE) {
+        DevLibSim::setInput(edge.source, edge.level);
+        return;
+    }
+    uint8_t index = (edge.source - INPUT_TRACE_PCF_SOURCE) / PCF_PORT_PINS;
+    if (index >= PCF_MAX_PORTS || _pcf[index] == nullptr) return;
+    _pcf[index]->setInput((edge.source - INPUT_TRACE_PCF_SOURCE) % PCF_PORT_PINS, edge.level);
+}
+
+void InputTraceReplay::_advanceTo(uint64_t timeUs) {
+    uint64_t now = DevLibSim::now();
+    if (timeUs <= now) return;
+    // whole timer ticks run the timers and the scheduler, the rest only moves the clock
+    uint64_t ms = (timeUs - now) / 1000;
+    ms -= ms % DEVLIB_TIMER_TICK_MS;
+    while (ms > 0) {
+        uint32_t step = ms > UINT32_MAX ? UINT32_MAX - UINT32_MAX % DEVLIB_TIMER_TICK_MS : (uint32_t) ms;
+        DevLibSim::advance(step);
+        ms -= step;
+    }
+    DevLibSim::advanceMicros((uint32_t) (timeUs - DevLibSim::now()));
+}
+
+void InputTraceReplay::_onEvent(uint8_t source, uint8_t event, uint32_t, void *arg) {
+    auto *self = static_cast<InputTraceReplay *>(arg);
+    if (source >= 128) return;
+    uint64_t now = DevLibSim::now() - self->_startUs;
+    self->_results.push_back({now, source, event, self->_lastEdgeUs[source]});
+}
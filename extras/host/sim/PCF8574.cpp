@@ -0,0 +1,79 @@
+#include <PCF8574.h>
+#include "DevLibSim.h"
+
+
+PCF8574::PCF8574(uint8_t address, TwoWire &wire) : _wire(wire), _address(address) {
+    _wire.attach(_address, this);
+}
+
+PCF8574::~PCF8574() {
+    _wire.detach(_address);
+}
+
+void PCF8574::pinMode(uint8_t pin, uint8_t mode) {
+    if (pin > 7) return;
+    // inputs are weak high outputs
+    if (mode != OUTPUT) _writePort(_latch | (1U << pin));
+}
+
+bool PCF8574::digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin > 7) return false;
+    return _writePort(value ? (_latch | (1U << pin)) : (_latch & ~(1U << pin)));
+}
+
+bool PCF8574::digitalWriteAll(uint8_t value) {
+    return _writePort(value);
+}
+
+uint8_t PCF8574::digitalRead(uint8_t pin, bool) {
+    if (pin > 7) return LOW;
+    return (digitalReadAll() >> pin) & 1;
+}
+
+uint8_t PCF8574::digitalReadAll() {
+    if (_wire.requestFrom(_address, (uint8_t) 1) != 1) return 0xFF;
+    return (uint8_t) _wire.read();
+}
+
+void PCF8574::setInput(uint8_t pin, bool level) {
+    if (pin > 7) return;
+    _external = level ? (_external | (1U << pin)) : (_external & ~(1U << pin));
+    _updateInterrupt();
+}
+
+void PCF8574::onI2CWrite(const uint8_t *data, size_t length) {
+    if (length == 0) return;
+    _latch = data[length - 1];
+    _updateInterrupt();
+}
+
+size_t PCF8574::onI2CRead(uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        data[i] = getPort();
+    }
+    _lastRead = getPort();
+    // a read clears the interrupt
+    if (_intActive) {
+        _intActive = false;
+        DevLibSim::releaseInput(_intPin);
+    }
+    return length;
+}
+
+bool PCF8574::_writePort(uint8_t value) {
+    _wire.beginTransmission(_address);
+    _wire.write(value);
+    return _wire.endTransmission() == 0;
+}
+
+void PCF8574::_updateInterrupt() {
+    if (_intPin == UINT8_MAX) return;
+    bool active = getPort() != _lastRead;
+    if (active == _intActive) return;
+    _intActive = active;
+    if (active) {
+        DevLibSim::setInput(_intPin, LOW);
+    } else {
+        DevLibSim::releaseInput(_intPin);
+    }
+}
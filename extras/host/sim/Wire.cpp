@@ -0,0 +1,77 @@
+#include <Wire.h>
+
+TwoWire Wire;
+
+
+void TwoWire::beginTransmission(uint8_t address) {
+    _address = address;
+    _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+    if (_txLength >= WIRE_BUFFER_LENGTH) return 0;
+    _txBuffer[_txLength++] = value;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t length) {
+    size_t n = 0;
+    while (n < length && write(data[n])) n++;
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+    SimI2CDevice *device = _find(_address);
+    if (device == nullptr) return 2; // address NACK
+    device->onI2CWrite(_txBuffer, _txLength);
+    _txLength = 0;
+    _writes++;
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t length, bool) {
+    _rxIndex = 0;
+    _rxLength = 0;
+    SimI2CDevice *device = _find(address);
+    if (device == nullptr) return 0;
+    if (length > WIRE_BUFFER_LENGTH) length = WIRE_BUFFER_LENGTH;
+    _rxLength = (uint8_t) device->onI2CRead(_rxBuffer, length);
+    _reads++;
+    return _rxLength;
+}
+
+int TwoWire::available() {
+    return _rxLength - _rxIndex;
+}
+
+int TwoWire::read() {
+    return _rxIndex < _rxLength ? _rxBuffer[_rxIndex++] : -1;
+}
+
+bool TwoWire::attach(uint8_t address, SimI2CDevice *device) {
+    for (uint8_t i = 0; i < _deviceCount; i++) {
+        if (_devices[i].address == address) {
+            _devices[i].device = device;
+            return true;
+        }
+    }
+    if (_deviceCount >= WIRE_SIM_DEVICES) return false;
+    _devices[_deviceCount++] = {address, device};
+    return true;
+}
+
+void TwoWire::detach(uint8_t address) {
+    for (uint8_t i = 0; i < _deviceCount; i++) {
+        if (_devices[i].address == address) {
+            _devices[i] = _devices[--_deviceCount];
+            return;
+        }
+    }
+}
+
+SimI2CDevice *TwoWire::_find(uint8_t address) const {
+    for (uint8_t i = 0; i < _deviceCount; i++) {
+        if (_devices[i].address == address) return _devices[i].device;
+    }
+    return nullptr;
+}
@@ -0,0 +1,75 @@
+/*
+ * ScheduleRun under concurrent producers: several threads push callbacks into both lanes
+ * while one thread runs the scheduler. Every accepted callback must run exactly once, and
+ * the callbacks of one producer must run in the order they were pushed.
+ *
+ *   ctest --test-dir build-host -R schedule_stress
+ */
+#include <Arduino.h>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "ScheduleRun.h"
+
+#define PRODUCERS 4
+#define PUSHES_PER_PRODUCER 200000
+
+static ScheduleRun scheduler;
+
+static std::atomic<uint32_t> accepted[PRODUCERS];
+static uint32_t executed[PRODUCERS];
+static uint32_t nextSeq[PRODUCERS];
+static uint32_t errors = 0;
+
+static void consume(uint8_t id, uint32_t seq) {
+    // pushes are retried until accepted, so a producer's sequence has no gap
+    if (seq != nextSeq[id]) {
+        if (errors++ < 10) printf("producer %u: got %u, expected %u\n", id, seq, nextSeq[id]);
+    }
+    nextSeq[id] = seq + 1;
+    executed[id]++;
+}
+
+static void produce(uint8_t id) {
+    // odd producers use the background lane: both rings get several producers
+    schedule_lane_t lane = id & 1 ? SCHEDULE_LANE_BACKGROUND : SCHEDULE_LANE_CRITICAL;
+    for (uint32_t seq = 0; seq < PUSHES_PER_PRODUCER; seq++) {
+        while (!scheduler.addSchedule([id, seq]() { consume(id, seq); }, lane)) {
+            std::this_thread::yield();
+        }
+        accepted[id]++;
+    }
+}
+
+int main() {
+    std::atomic<bool> done{false};
+    std::thread consumer([&done]() {
+        // keep draining until the producers are done and the lanes are empty
+        while (!scheduler.run() || !done) {
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (uint8_t id = 0; id < PRODUCERS; id++) {
+        producers.emplace_back(produce, id);
+    }
+    for (auto &producer: producers) producer.join();
+    done = true;
+    consumer.join();
+
+    uint32_t total = 0;
+    for (uint8_t id = 0; id < PRODUCERS; id++) {
+        printf("producer %u: accepted %u, executed %u\n", id, accepted[id].load(), executed[id]);
+        if (executed[id] != PUSHES_PER_PRODUCER || accepted[id] != PUSHES_PER_PRODUCER) errors++;
+        total += executed[id];
+    }
+    schedule_stats_t stats = scheduler.getStats();
+    printf("dispatched %u, dropped %u, shed %u, high water %u\n",
+           stats.dispatched, stats.dropped, stats.shed, stats.highWater);
+    if (stats.dispatched != total || stats.depth != 0) errors++;
+
+    printf("%s\n", errors == 0 ? "PASS" : "FAIL");
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/*
+ * StateJournal on the stdio storage: the states written by one journal must be recovered by a
+ * new journal on the same file, across ring compactions, torn records and a lost snapshot.
+ *
+ *   ctest --test-dir build-host -R state_journal
+ */
+#include <Arduino.h>
+#include <cstdio>
+#include "StateJournal.h"
+
+#define JOURNAL_FILE "state_journal_test.bin"
+#define DEVICES 40
+
+static uint32_t errors = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        errors++; \
+        printf("line %d: ", __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+static String key(uint8_t i) {
+    return "p" + String(i);
+}
+
+/* expected state of every device, kept next to the journal */
+static bool expected[DEVICES];
+
+static void checkRecovered(const char *step, uint32_t records) {
+    StdioJournalStorage storage(JOURNAL_FILE);
+    StateJournal journal(storage);
+    CHECK(journal.begin(), "%s: begin failed", step);
+    for (uint8_t i = 0; i < DEVICES; i++) {
+        // a device never switched on has no record, the default is its state
+        CHECK(journal.getBool(key(i), false) == expected[i], "%s: %s is %d, expected %d", step,
+              key(i).c_str(), !expected[i], expected[i]);
+    }
+    CHECK(journal.getStats().recovered == records, "%s: %u records replayed, expected %u", step,
+          journal.getStats().recovered, records);
+}
+
+/* the first open fails, as a filesystem that is not mounted yet */
+class LateStorage : public StdioJournalStorage {
+public:
+    using StdioJournalStorage::StdioJournalStorage;
+    uint8_t opens = 0;
+
+    bool open(uint32_t size) override {
+        return ++opens > 1 && StdioJournalStorage::open(size);
+    }
+};
+
+int main() {
+    remove(JOURNAL_FILE);
+
+    /* replay: every change is a record after the last snapshot */
+    uint32_t records = 0;
+    {
+        StdioJournalStorage storage(JOURNAL_FILE);
+        StateJournal journal(storage);
+        for (uint8_t i = 0; i < DEVICES; i++) {
+            expected[i] = i % 3 == 0;
+            CHECK(journal.set(key(i), expected[i]), "set %s", key(i).c_str());
+            records += expected[i]; // an unchanged state appends nothing
+        }
+        CHECK(journal.getStats().appended == records, "%u appended, expected %u", journal.getStats().appended,
+              records);
+    }
+    checkRecovered("replay", records);
+
+    /* compaction: the ring wraps several times, only the records of the last lap are replayed */
+    uint32_t appended = 0;
+    {
+        StdioJournalStorage storage(JOURNAL_FILE);
+        StateJournal journal(storage);
+        for (uint32_t n = 0; n < 3 * JOURNAL_RING_RECORDS + 100; n++) {
+            uint8_t i = (n * 7) % DEVICES;
+            expected[i] = !expected[i];
+            CHECK(journal.set(key(i), expected[i]), "set %s", key(i).c_str());
+        }
+        appended = journal.getStats().appended;
+        CHECK(journal.getStats().compactions == 3, "%u compactions, expected 3", journal.getStats().compactions);
+    }
+    checkRecovered("compaction", (records + appended) % JOURNAL_RING_RECORDS);
+
+    /* explicit compaction: nothing left to replay */
+    {
+        StdioJournalStorage storage(JOURNAL_FILE);
+        StateJournal journal(storage);
+        CHECK(journal.compact(), "compact failed");
+    }
+    checkRecovered("compact", 0);
+
+    /* torn record: the replay stops at the first invalid record, the ones before it are kept */
+    {
+        StdioJournalStorage storage(JOURNAL_FILE);
+        StateJournal journal(storage);
+        for (uint8_t i = 0; i < 3; i++) {
+            expected[i] = !expected[i];
+            journal.set(key(i), expected[i]);
+        }
+        journal.set(key(3), !expected[3]); // torn below
+        uint32_t offset = 2 * sizeof(journal_snapshot_t) + 3 * sizeof(journal_record_t);
+        uint8_t garbage[sizeof(journal_record_t) / 2] = {0xFF, 0x00, 0xFF};
+        storage.write(offset + sizeof(garbage), garbage, sizeof(garbage));
+    }
+    checkRecovered("torn", 3);
+
+    /* lost snapshot: the older one is used, the records of the newer lap do not continue it */
+    {
+        StdioJournalStorage storage(JOURNAL_FILE);
+        StateJournal journal(storage);
+        journal.compact();
+        bool older[DEVICES];
+        memcpy(older, expected, sizeof(older));
+        for (uint8_t i = 0; i < 5; i++) {
+            expected[i] = !expected[i];
+            journal.set(key(i), expected[i]);
+        }
+        journal.compact();
+        journal.set(key(5), !expected[5]);
+        // break the magic of the newest snapshot
+        journal_snapshot_t snapshots[2];
+        storage.read(0, snapshots, sizeof(snapshots));
+        uint8_t newest = (int32_t) (snapshots[1].seq - snapshots[0].seq) > 0 ? 1 : 0;
+        uint32_t zero = 0;
+        storage.write(newest * sizeof(journal_snapshot_t), &zero, sizeof(zero));
+        memcpy(expected, older, sizeof(older));
+    }
+    checkRecovered("lost snapshot", 0);
+
+    /* begin() fails while the storage can not be opened and succeeds on a later call */
+    {
+        LateStorage storage(JOURNAL_FILE);
+        StateJournal journal(storage);
+        CHECK(!journal.begin(), "begin succeeded without storage");
+        CHECK(journal.begin(), "begin did not retry the storage");
+        CHECK(storage.opens == 2, "%u opens, expected 2", storage.opens);
+    }
+
+    remove(JOURNAL_FILE);
+    printf("%s: %u errors\n", errors ? "FAIL" : "PASS", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,54 @@
+#ifndef CRITICALSECTION_H
+#define CRITICALSECTION_H
+
+#include <Arduino.h>
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#elif !defined(ESP8266)
+#include <atomic>
+#endif
+
+/**
+ * @brief Short critical section shared by tasks, timer callbacks and ISRs.
+ *
+ * ESP32: spinlock, safe across both cores and from ISR.
+ * ESP8266: masks interrupts. Single core, so the saved level can live in the object (never nested).
+ * Host: spinlock, so the host tests can use the library from several threads.
+ */
+class CriticalSection {
+public:
+    constexpr CriticalSection() = default;
+
+    inline void IRAM_ATTR enter() {
+#if defined(ESP32)
+        portENTER_CRITICAL_SAFE(&_mux);
+#elif defined(ESP8266)
+        _savedPS = xt_rsil(15);
+#else
+        while (_flag.test_and_set(std::memory_order_acquire)) {}
+#endif
+    }
+
+    inline void IRAM_ATTR exit() {
+#if defined(ESP32)
+        portEXIT_CRITICAL_SAFE(&_mux);
+#elif defined(ESP8266)
+        xt_wsr_ps(_savedPS);
+#else
+        _flag.clear(std::memory_order_release);
+#endif
+    }
+
+private:
+#if defined(ESP32)
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+#elif defined(ESP8266)
+    uint32_t _savedPS = 0;
+#else
+    std::atomic_flag _flag = ATOMIC_FLAG_INIT;
+#endif
+};
+
+
+#endif //CRITICALSECTION_H
@@ -1,30 +1,71 @@
 #ifndef DEVICE_LIB_TYPES_H
 #define DEVICE_LIB_TYPES_H
 
+#include <cstdint>
 #include <functional>
+#include "InlineFunction.h"
 
 #define DEVICE_LIB_VERSION "1.0.0"
 #define DEVICE_LIB_VERSION_NUM 1
 
+/* Inline storage for callbacks in bytes. A lambda capturing `this` needs one pointer */
+#ifndef DEVLIB_CALLBACK_SIZE
+#define DEVLIB_CALLBACK_SIZE (4 * sizeof(void *))
+#endif
+
+typedef InlineFunction<DEVLIB_CALLBACK_SIZE> devlib_function_t;
+
 struct devlib_callback_t {
-    std::function<void()> fn = nullptr;
+    devlib_function_t fn = nullptr;
     bool schedule = false;
+    const char *tag = nullptr; // registration site in the scheduler stats, static string
 
     devlib_callback_t() = default;
-    explicit devlib_callback_t(std::function<void()> callback, bool schedule = true)
-        : fn(std::move(callback)), schedule(schedule) {}
+    explicit devlib_callback_t(devlib_function_t callback, bool schedule = true, const char *tag = nullptr)
+        : fn(std::move(callback)), schedule(schedule), tag(tag) {}
     bool isValid() const {
         return fn != nullptr;
     }
-    void assign(std::function<void()> &callback, bool schedule = true) {
+    void assign(devlib_function_t callback, bool schedule = true, const char *tag = nullptr) {
         fn = std::move(callback);
         this->schedule = schedule;
+        this->tag = tag;
     }
     void operator()() const {
         if (fn != nullptr) {
             fn();
         }
     }
+
+    /**
+     * @brief Trampoline to schedule a callback by reference instead of copying it
+     * @param arg devlib_callback_t
+     */
+    static void invoke(void *arg) {
+        (*static_cast<devlib_callback_t *>(arg))();
+    }
 };
 
+#define DEVLIB_HASH_INIT 2166136261UL
+
+/**
+ * @brief Continue a devlib_key_hash() with more characters: the hash of "ab" is
+ * devlib_hash_append(devlib_key_hash("a"), "b")
+ * @param hash DEVLIB_HASH_INIT or a previous hash
+ */
+inline uint32_t devlib_hash_append(uint32_t hash, const char *str) {
+    while (str != nullptr && *str) {
+        hash ^= (uint8_t) *str++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * @brief 32-bit hash of a device key ("p13", "p5613", ...), FNV-1a
+ */
+inline uint32_t devlib_key_hash(const char *key) {
+    return devlib_hash_append(DEVLIB_HASH_INIT, key);
+}
+
 #endif // DEVICE_LIB_TYPES_H
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "GenericOutputBase.h"
+
+#if defined(USE_FBRTDB) && FBRTDB_LIB_TYPE == 1
+
+FBRTDBBatch GO_DBBatch;
+
+void FBRTDBBatch::schedule() {
+    _lock.enter();
+    bool first = !_scheduled;
+    if (first) {
+        _scheduled = true;
+        _firstPendingUs = micros();
+    }
+    _lock.exit();
+    if (first && !GPIO_Scheduler.addSchedule(_flushTask, this, SCHEDULE_LANE_BACKGROUND)) {
+        _lock.enter();
+        _scheduled = false;
+        _lock.exit();
+        GPIO_Timer.arm(&_retryTimer, FBRTDB_BATCH_RETRY_MS);
+    }
+}
+
+uint16_t FBRTDBBatch::flush() {
+    _lock.enter();
+    _scheduled = false; // changes from now on schedule another flush
+    uint32_t firstPendingUs = _firstPendingUs;
+    _lock.exit();
+
+    uint16_t sent = 0;
+    for (size_t i = 0; i < attachedDBDevices.size(); i++) {
+        GenericOutputBase *device = attachedDBDevices[i];
+        if (device->_dbPending && device->_fbRTDBconfig != nullptr) {
+            // first pending device of this config, _send() takes the others after it
+            sent += _send(device->_fbRTDBconfig, i);
+        }
+    }
+    if (sent > 0) {
+        uint32_t latency = micros() - firstPendingUs;
+        _stats.lastLatency = latency;
+        if (latency > _stats.maxLatency) _stats.maxLatency = latency;
+    }
+    return sent;
+}
+
+uint16_t FBRTDBBatch::_send(stdGenericOutput::fbrtdb_config_t *config, size_t from) {
+    if (config->path.length() == 0) {
+        Serial.printf("[Err][Update] %s: DB path not found\n", attachedDBDevices[from]->_dbSubPath.c_str());
+        for (size_t i = from; i < attachedDBDevices.size(); i++) {
+            if (attachedDBDevices[i]->_fbRTDBconfig == config) attachedDBDevices[i]->_dbPending = false;
+        }
+        return 0;
+    }
+    _json.clear();
+    uint16_t count = 0;
+    for (size_t i = from; i < attachedDBDevices.size(); i++) {
+        GenericOutputBase *device = attachedDBDevices[i];
+        if (!device->_dbPending || device->_fbRTDBconfig != config) continue;
+        device->_dbPending = false; // cleared before reading the state, a newer change marks it again
+        _json.set(device->_dbSubPath, device->_state);
+        count++;
+    }
+    Serial.printf("[Update] %s: %u devices\n", config->path.c_str(), count);
+    if (!Firebase.RTDB.updateNodeSilent(config->fbdo, config->path, &_json)) {
+        Serial.printf("[Err][Update] %s: %s\n", config->path.c_str(), config->fbdo->errorReason().c_str());
+        _stats.failed++;
+    }
+    _stats.requests++;
+    _stats.updates += count;
+    _stats.lastBatch = count;
+    if (count > _stats.maxBatch) _stats.maxBatch = count;
+    return count;
+}
+
+void FBRTDBBatch::_flushTask(void *arg) {
+    static_cast<FBRTDBBatch *>(arg)->flush();
+}
+
+void FBRTDBBatch::_retryTask(void *arg) {
+    static_cast<FBRTDBBatch *>(arg)->schedule();
+}
+
+#endif // USE_FBRTDB && FBRTDB_LIB_TYPE == 1
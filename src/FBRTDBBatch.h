@@ -0,0 +1,80 @@
+#ifndef FBRTDBBATCH_H
+#define FBRTDBBATCH_H
+
+#include <Arduino.h>
+#include <Firebase_ESP_Client.h>
+#include "CriticalSection.h"
+#include "TimerWheel.h"
+
+/* Retry delay when the background lane of GPIO_Scheduler is full */
+#ifndef FBRTDB_BATCH_RETRY_MS
+#define FBRTDB_BATCH_RETRY_MS 100
+#endif
+
+namespace stdGenericOutput {
+    struct fbrtdb_config_t;
+}
+
+struct fbrtdb_batch_stats_t {
+    uint32_t requests = 0;    // updateNodeSilent() calls
+    uint32_t updates = 0;     // device states sent
+    uint32_t failed = 0;      // failed requests
+    uint16_t lastBatch = 0;   // states in the last request
+    uint16_t maxBatch = 0;
+    uint32_t lastLatency = 0; // us from the first pending change to the end of the flush
+    uint32_t maxLatency = 0;
+};
+
+/**
+ * @brief Batches the database updates of attached devices.
+ *
+ * A state change only marks the device pending and schedules one flush on GPIO_Scheduler.
+ * The flush walks attachedDBDevices once and sends a single multi-path update per
+ * fbrtdb_config_t with every pending device of that config, so "all off" on 32 devices
+ * is one request instead of 32. The JSON object is reused between flushes.
+ *
+ * The flush runs in the background lane. If the lane is full, the schedule is retried after
+ * FBRTDB_BATCH_RETRY_MS; the pending flags keep every change meanwhile.
+ */
+class FBRTDBBatch {
+public:
+    FBRTDBBatch() = default;
+
+    /**
+     * @brief Schedule a flush if none is pending. Safe from timer callbacks
+     */
+    void schedule();
+
+    /**
+     * @brief Send every pending device state now
+     * @return number of states sent
+     */
+    uint16_t flush();
+
+    fbrtdb_batch_stats_t getStats() const {
+        return _stats;
+    }
+
+    void resetStats() {
+        _stats = fbrtdb_batch_stats_t();
+    }
+
+private:
+    FirebaseJson _json;
+    bool _scheduled = false;
+    uint32_t _firstPendingUs = 0;
+    fbrtdb_batch_stats_t _stats;
+    CriticalSection _lock;
+    timer_node_t _retryTimer{_retryTask, this};
+
+    uint16_t _send(stdGenericOutput::fbrtdb_config_t *config, size_t from);
+
+    static void _flushTask(void *arg);
+
+    static void _retryTask(void *arg);
+};
+
+extern FBRTDBBatch GO_DBBatch;
+
+
+#endif //FBRTDBBATCH_H
@@ -0,0 +1,87 @@
+#include "GenericOutputBase.h"
+
+#if defined(USE_FBRTDB) && FBRTDB_LIB_TYPE == 1
+#include <algorithm>
+
+FBRTDBDispatcher GO_DBDispatcher;
+
+/* hash of "<parent>/<key>", or "<key>" at the root */
+static uint32_t _hashChild(uint32_t parent, bool root, const String &key) {
+    if (!root) parent = devlib_hash_append(parent, "/");
+    return devlib_hash_append(parent, key.c_str());
+}
+
+uint16_t FBRTDBDispatcher::dispatch(FirebaseStream *data, stdGenericOutput::fbrtdb_config_t *dbconfig,
+                                    bool onlyProcessWithPutMethod) {
+    if (onlyProcessWithPutMethod && data->eventType() != "put") return 0;
+    if (_dirty) _rebuild();
+    if (_index.empty()) return 0;
+
+    // path of the event relative to the stream, without the leading and trailing "/"
+    String path = data->dataPath();
+    while (path.startsWith("/")) path.remove(0, 1);
+    if (path.endsWith("/")) path.remove(path.length() - 1);
+
+    int type = data->dataTypeEnum();
+    if (type == d_boolean) {
+        return _apply(dbconfig, devlib_key_hash(path.c_str()), "", path, data->boolData());
+    }
+    if (type != d_json) return 0;
+
+    /* one pass over the payload, the hash of each parent object is kept per depth */
+    String parents[FBRTDB_DISPATCH_MAX_DEPTH + 1];
+    uint32_t hashes[FBRTDB_DISPATCH_MAX_DEPTH + 1];
+    parents[0] = path;
+    hashes[0] = devlib_key_hash(path.c_str());
+    uint16_t matched = 0;
+    FirebaseJson *json = data->jsonObjectPtr();
+    size_t count = json->iteratorBegin();
+    for (size_t i = 0; i < count; i++) {
+        FirebaseJson::IteratorValue value = json->valueAt(i);
+        if (value.depth < 0 || value.depth >= FBRTDB_DISPATCH_MAX_DEPTH) continue;
+        const String &parent = parents[value.depth];
+        uint32_t hash = _hashChild(hashes[value.depth], parent.length() == 0, value.key);
+        if (value.type == FirebaseJson::JSON_OBJECT) {
+            parents[value.depth + 1] = parent.length() ? parent + "/" + value.key : value.key;
+            hashes[value.depth + 1] = hash;
+            continue;
+        }
+        if (value.value != "true" && value.value != "false") continue;
+        matched += _apply(dbconfig, hash, parent, value.key, value.value == "true");
+    }
+    json->iteratorEnd();
+    return matched;
+}
+
+void FBRTDBDispatcher::_rebuild() {
+    _index.clear();
+    _index.reserve(attachedDBDevices.size());
+    for (GenericOutputBase *device : attachedDBDevices) {
+        if (device->_dbSubPath.length() == 0) continue;
+        _index.push_back({devlib_key_hash(device->_dbSubPath.c_str()), device});
+    }
+    std::sort(_index.begin(), _index.end(), [](const entry_t &a, const entry_t &b) {
+        return a.hash < b.hash;
+    });
+    _dirty = false;
+}
+
+uint16_t FBRTDBDispatcher::_apply(stdGenericOutput::fbrtdb_config_t *dbconfig, uint32_t hash,
+                                  const String &parent, const String &key, bool state) {
+    auto it = std::lower_bound(_index.begin(), _index.end(), hash, [](const entry_t &entry, uint32_t h) {
+        return entry.hash < h;
+    });
+    if (it == _index.end() || it->hash != hash) return 0;
+    // the full path is only built on a hash hit
+    String path = parent.length() ? parent + "/" + key : key;
+    uint16_t matched = 0;
+    for (; it != _index.end() && it->hash == hash; ++it) {
+        // devices of other streams share the index, same sub-path under another root
+        if (it->device->_fbRTDBconfig != dbconfig || it->device->_dbSubPath != path) continue;
+        it->device->syncState(state);
+        matched++;
+    }
+    return matched;
+}
+
+#endif // USE_FBRTDB && FBRTDB_LIB_TYPE == 1
@@ -0,0 +1,68 @@
+#ifndef FBRTDBDISPATCHER_H
+#define FBRTDBDISPATCHER_H
+
+#include <Arduino.h>
+#include <vector>
+#include <Firebase_ESP_Client.h>
+
+namespace stdGenericOutput {
+    class GenericOutputBase;
+    struct fbrtdb_config_t;
+}
+
+/* Maximum depth of the JSON object of a stream event */
+#ifndef FBRTDB_DISPATCH_MAX_DEPTH
+#define FBRTDB_DISPATCH_MAX_DEPTH 8
+#endif
+
+/**
+ * @brief Dispatches Firebase stream events to the attached devices.
+ *
+ * Call dispatch() once from the stream callback instead of syncState() on every device.
+ * Only the devices attached with the config of the stream are considered.
+ * The event is parsed once: every boolean leaf of the payload is turned into a full
+ * sub-path and looked up in a sorted hash index of the devices' sub-paths. Root "/" snapshots
+ * with hundreds of keys, partial objects ("/room" -> {"light": true}) and single values are handled.
+ *
+ * The index is rebuilt on the next event after a device is attached or detached.
+ */
+class FBRTDBDispatcher {
+public:
+    FBRTDBDispatcher() = default;
+
+    /**
+     * @brief Apply a stream event to the devices
+     * @param data FirebaseStream
+     * @param dbconfig config of the stream, as passed to attachDatabase()
+     * @param onlyProcessWithPutMethod ignore "patch" events
+     * @return number of devices matched
+     */
+    uint16_t dispatch(FirebaseStream *data, stdGenericOutput::fbrtdb_config_t *dbconfig,
+                      bool onlyProcessWithPutMethod = true);
+
+    /**
+     * @brief Mark the index as outdated. Called when a device is attached or detached
+     */
+    void invalidate() {
+        _dirty = true;
+    }
+
+private:
+    struct entry_t {
+        uint32_t hash;
+        stdGenericOutput::GenericOutputBase *device;
+    };
+
+    std::vector<entry_t> _index;
+    bool _dirty = true;
+
+    void _rebuild();
+
+    uint16_t _apply(stdGenericOutput::fbrtdb_config_t *dbconfig, uint32_t hash, const String &parent,
+                    const String &key, bool state);
+};
+
+extern FBRTDBDispatcher GO_DBDispatcher;
+
+
+#endif //FBRTDBDISPATCHER_H
@@ -0,0 +1,130 @@
+#ifndef FASTOUTPUT_H
+#define FASTOUTPUT_H
+
+#include <Arduino.h>
+
+#if defined(ESP32)
+#include <soc/gpio_reg.h>
+#include <soc/soc_caps.h>
+#endif
+
+/**
+ * @brief On-chip output with the pin known at compile time, written straight to the GPIO
+ * set/clear registers (GPIO_OUT_W1TS/W1TC on ESP32, GPOS/GPOC on ESP8266).
+ *
+ * The register, the mask and the polarity are resolved at compile time, so on()/off()
+ * are a single register store. No callbacks, last state, PCF or database: use it for
+ * pulse-critical loads (solenoids, stepper enables).
+ *
+ * Example:
+ * @code
+ * FastOutput<12, HIGH> valve;
+ * valve.on();
+ * delayMicroseconds(50);
+ * valve.off();
+ * @endcode
+ *
+ * @tparam Pin on-chip GPIO number
+ * @tparam ActiveState LOW or HIGH
+ */
+template<uint8_t Pin, bool ActiveState = LOW>
+class FastOutput {
+public:
+#if defined(ESP32)
+    static_assert(Pin < SOC_GPIO_PIN_COUNT, "FastOutput: invalid pin");
+#elif defined(ESP8266)
+    static_assert(Pin <= 16, "FastOutput: invalid pin");
+#endif
+
+    FastOutput() {
+        pinMode(Pin, OUTPUT);
+    }
+
+    /**
+     * @brief Write the current state to the pin
+     */
+    void begin() {
+        _write(_state);
+    }
+
+    /**
+     * @brief Set power to ON
+     */
+    inline __attribute__((always_inline)) void on() {
+        _state = true;
+        _write(true);
+    }
+
+    /**
+     * @brief Set power to OFF
+     */
+    inline __attribute__((always_inline)) void off() {
+        _state = false;
+        _write(false);
+    }
+
+    /**
+     * @brief Toggle power
+     */
+    inline __attribute__((always_inline)) void toggle() {
+        _state ? off() : on();
+    }
+
+    /**
+     * @brief Set the power state
+     * @param state
+     */
+    inline __attribute__((always_inline)) void setState(bool state) {
+        state ? on() : off();
+    }
+
+    /**
+     * @brief Get current state of the device
+     * @return true when ON
+     */
+    bool getState() const {
+        return _state;
+    }
+
+    bool getActiveState() const {
+        return ActiveState;
+    }
+
+    uint8_t getPin() const {
+        return Pin;
+    }
+
+private:
+    bool _state = false;
+
+    static inline __attribute__((always_inline)) void _write(bool state) {
+        // level HIGH when the state matches the active state
+        _level(state == (ActiveState == HIGH));
+    }
+
+    static inline __attribute__((always_inline)) void _level(bool high) {
+#if defined(ESP32)
+#if SOC_GPIO_PIN_COUNT > 32
+        if (Pin >= 32) {
+            REG_WRITE(high ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, 1UL << (Pin - 32));
+            return;
+        }
+#endif
+        REG_WRITE(high ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, 1UL << (Pin & 31));
+#elif defined(ESP8266)
+        if (Pin == 16) {
+            // GPIO16 is on the RTC block, it has no set/clear register
+            GP16O = high ? 1 : 0;
+        } else if (high) {
+            GPOS = 1UL << (Pin & 15);
+        } else {
+            GPOC = 1UL << (Pin & 15);
+        }
+#else
+        digitalWrite(Pin, high ? HIGH : LOW);
+#endif
+    }
+};
+
+
+#endif //FASTOUTPUT_H
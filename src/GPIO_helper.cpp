@@ -4,6 +4,22 @@
 
 #include "GPIO_helper.h"
 
-#if defined(ESP32)
 ScheduleRun GPIO_Scheduler;
-#endif
\ No newline at end of file
+
+TimerWheel GPIO_Timer;
+
+#if defined(ESP8266)
+#include <Schedule.h>
+
+/*
+ * Drain the scheduler between two loop() iterations, like schedule_function() did: sketches do not
+ * need to call run(). Not a recurrent function, those also run inside yield() and delay().
+ * A function scheduled while the core runs them waits for the next iteration.
+ */
+static void _drainGPIOScheduler() {
+    GPIO_Scheduler.run();
+    schedule_function(_drainGPIOScheduler);
+}
+
+[[maybe_unused]] static bool _gpioSchedulerAttached = schedule_function(_drainGPIOScheduler);
+#endif
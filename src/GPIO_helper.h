@@ -2,13 +2,13 @@
 #define GPIO_HELPER_H
 
 
-/* Schedule for esp32 */
-#if defined(ESP32)
+/* Schedule for deferred callbacks. On ESP8266 it is drained between two loop() iterations */
 #include "ScheduleRun.h"
 extern ScheduleRun GPIO_Scheduler;
-#else
-#include <Schedule.h>
-#endif
+
+/* Timer shared by every device */
+#include "TimerWheel.h"
+extern TimerWheel GPIO_Timer;
 
 
 
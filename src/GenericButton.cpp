@@ -1,8 +1,5 @@
 #include "GenericButton.h"
-
-uint32_t GenericButton::_gcd(uint32_t a, uint32_t b) {
-    return b == 0 ? a : _gcd(b, a % b);
-}
+#include <algorithm>
 
 void GenericButton::_autoAdjustIdleTime() {
     if (_default_idle_time <= _default_dbclick_time) {
@@ -12,79 +9,148 @@ void GenericButton::_autoAdjustIdleTime() {
     }
 }
 
-void GenericButton::_autoAdjustTickTime() {
-    uint32_t gcdVal = _default_hold_time;
-    for (auto &cb: _callbacks) {
-        if (cb.event == BUTTON_EVENT_PRESS_HOLD) {
-            gcdVal = _gcd(gcdVal, cb.param);
+void GenericButton::_armHoldTimer(uint32_t after) {
+    uint32_t next = UINT32_MAX;
+    const generic_button_bucket_t &longClick = _buckets[BUTTON_EVENT_LONG_CLICK];
+    if (_default_hold_time > after && longClick.fired != (1ULL << longClick.count) - 1) {
+        next = _default_hold_time;
+    }
+    /* sorted: the first unfired listener past `after` is the nearest */
+    const generic_button_bucket_t &hold = _buckets[BUTTON_EVENT_PRESS_HOLD];
+    for (uint8_t i = 0; i < hold.count; i++) {
+        uint32_t param = _listener(hold, i).param;
+        if (param >= next) break;
+        if (param > after && !(hold.fired & (1UL << i))) {
+            next = param;
+            break;
         }
     }
-    _hold_time_tick = (gcdVal < 50) ? 50 : gcdVal;
-    GI_DEBUG_PRINTF("[Button][%d] _hold_time_tick based onEvent gcd = %u\n", _pin, _hold_time_tick);
+    if (next == UINT32_MAX) {
+        // nothing to wait for, but a pending click or idle timer must not run while pressed
+        GPIO_Timer.cancel(&_btnTimer);
+        return;
+    }
+    // relative to the press edge, which is already a debounce time old
+    uint32_t held = millis() - _last_press_time;
+    _startButtonTimer(BUTTON_TIMER_HOLD, next > held ? next - held : 0);
+}
+
+void GenericButton::onEvent(generic_button_event_t event, devlib_function_t cb, uint32_t param, bool schedule,
+                            const char *tag) {
+    if (event >= BUTTON_EVENT_COUNT) return;
+    generic_button_bucket_t &bucket = _buckets[event];
+    if (bucket.count >= BUTTON_MAX_LISTENERS || _listenerCount == UINT8_MAX) {
+        Serial.printf("[Err][GenericButton] Too many listeners, increase BUTTON_MAX_LISTENERS (%d)\n",
+                      BUTTON_MAX_LISTENERS);
+        return;
+    }
+    uint8_t slot = _listenerCount;
+    if (slot >= BUTTON_INLINE_LISTENERS && (slot - BUTTON_INLINE_LISTENERS) % BUTTON_INLINE_LISTENERS == 0) {
+        // inline slots and blocks full: chain a new block, the registered listeners stay in place
+        auto *block = new generic_button_block_t;
+        generic_button_block_t **tail = &_blocks;
+        while (*tail != nullptr) tail = &(*tail)->next;
+        *tail = block;
+    }
+    _listenerCount++;
+    generic_button_cb_t &listener = _slot(slot);
+    listener.event = event;
+    listener.param = param;
+    listener.callback.assign(std::move(cb), schedule, tag);
+
+    uint8_t *pos = bucket.order + bucket.count;
+    if (event == BUTTON_EVENT_CLICK_COUNT || event == BUTTON_EVENT_PRESS_HOLD) {
+        // keyed events: sorted by count / hold time, registration order for equal keys
+        pos = std::upper_bound(bucket.order, bucket.order + bucket.count, param,
+                               [this](uint32_t value, uint8_t other) { return value < _slot(other).param; });
+    }
+    // the fired bits follow their listeners
+    uint8_t index = pos - bucket.order;
+    uint32_t low = bucket.fired & ((1UL << index) - 1);
+    bucket.fired = low | ((bucket.fired & ~low) << 1);
+    memmove(pos + 1, pos, bucket.count - index);
+    *pos = slot;
+    bucket.count++;
+    _init();
 }
 
-void GenericButton::_execCallback(generic_button_cb_t *cb) {
-    if (cb == nullptr || cb->callback.fn == nullptr) return;
-    if (cb->excuted) return;
-    GenericInput::_execCallback(cb->callback);
-    cb->excuted = true;
+generic_button_cb_t &GenericButton::_slot(uint8_t slot) {
+    if (slot < BUTTON_INLINE_LISTENERS) return _listeners[slot];
+    generic_button_block_t *block = _blocks;
+    for (slot -= BUTTON_INLINE_LISTENERS; slot >= BUTTON_INLINE_LISTENERS; slot -= BUTTON_INLINE_LISTENERS) {
+        block = block->next;
+    }
+    return block->listeners[slot];
+}
+
+void GenericButton::_execListener(generic_button_bucket_t &bucket, uint8_t i) {
+    uint32_t bit = 1UL << i;
+    if (bucket.fired & bit) return;
+    generic_button_cb_t &cb = _listener(bucket, i);
+    if (cb.callback.fn == nullptr) return;
+#if defined(USE_INPUT_TRACE)
+    GI_Trace.event(_traceSource(), cb.event);
+#endif
+    GenericInput::_execCallback(cb.callback);
+    bucket.fired |= bit;
+}
+
+void GenericButton::_execClickCount(uint8_t count) {
+    generic_button_bucket_t &bucket = _buckets[BUTTON_EVENT_CLICK_COUNT];
+    const uint8_t *end = bucket.order + bucket.count;
+    const uint8_t *first = std::lower_bound((const uint8_t *) bucket.order, end, count,
+                                            [this](uint8_t slot, uint32_t value) { return _slot(slot).param < value; });
+    for (const uint8_t *it = first; it != end && _slot(*it).param == count; ++it) {
+        _execListener(bucket, it - bucket.order);
+    }
+}
+
+void GenericButton::_onButtonTimer(void *arg) {
+    auto *button = static_cast<GenericButton *>(arg);
+    switch (button->_btnTimerType) {
+        case BUTTON_TIMER_HOLD:
+            // one shot per hold time, then the next one
+            button->_process_hold();
+            if (button->_last_press_time != 0) button->_armHoldTimer(millis() - button->_last_press_time);
+            break;
+        case BUTTON_TIMER_CLICK:
+            button->_process_click();
+            /* timer to process idle */
+            button->_startButtonTimer(BUTTON_TIMER_IDLE, button->_default_idle_time - button->_default_dbclick_time);
+            break;
+        case BUTTON_TIMER_IDLE:
+            button->_process_idle();
+            break;
+    }
 }
 
 void GenericButton::_processHandler() {
-    bool currentState = _read(true);
+    bool currentState = _sample();
     if (currentState == _lastState) return;
     _lastState = currentState;
+    _stateTime = _settledEdgeTime(currentState);
+    // time of the settled edge on the millis() clock: the windows do not include the debounce and loop delays
+    uint32_t edgeTime = millis() - (micros() - _stateTime) / 1000;
     if (currentState == _activeState) {
         _state = BUTTON_STATE_PRESSED;
-        _last_press_time = millis();
-        GI_DEBUG_PRINTF("[Button][%d][%lu] Pressed\n", _pin, millis());
+        _last_press_time = edgeTime;
+        GI_DEBUG_PRINTF("[Button][%d][%lu] Pressed\n", _pin, edgeTime);
         if (_click_count == 0)
             _click_count = 1;
-        if (millis() - _last_release_time < _default_dbclick_time) {
+        if (edgeTime - _last_release_time < _default_dbclick_time) {
             ++_click_count;
         }
 /* hold event process */
-#if defined(ESP8266)
-        _ticker.attach_ms(_hold_time_tick, [this]() {
-            _process_hold();
-        });
-#elif defined(ESP32)
-        _btnTimerArg.callback = std::bind(&GenericButton::_process_hold, this);
-                    if (_btnTimer != nullptr) {
-                        esp_timer_stop(_btnTimer);
-                        esp_timer_start_periodic(_btnTimer, _hold_time_tick * 1000);
-                    }
-#endif
+        _armHoldTimer(0);
 /* press event process */
         _process_press();
     } else {
         _state = BUTTON_STATE_RELEASED;
-        _last_release_time = millis();
-        GI_DEBUG_PRINTF("[Button][%d][%lu] Released\n", _pin, millis());
+        _last_release_time = edgeTime;
+        GI_DEBUG_PRINTF("[Button][%d][%lu] Released\n", _pin, edgeTime);
 /* timer to process click event */
-#if defined(ESP8266)
-        _ticker.once_ms(_default_dbclick_time, [this]() {
-            _process_click();
-/* timer to process idle */
-            _ticker.once_ms(_default_idle_time - _default_dbclick_time, [this]() {
-                _process_idle();
-            });
-        });
-#elif defined(ESP32)
-        _btnTimerArg.callback = [this]() {
-                        _process_click();
-                        /* timer to process idle */
-                        if (_btnTimer != nullptr) {
-                            _btnTimerArg.callback = std::bind(&GenericButton::_process_idle, this);
-                            esp_timer_stop(_btnTimer);
-                            esp_timer_start_once(_btnTimer, (_default_idle_time - _default_dbclick_time) * 1000);
-                        }
-                    };
-                    if (_btnTimer != nullptr) {
-                        esp_timer_stop(_btnTimer);
-                        esp_timer_start_once(_btnTimer, _default_dbclick_time * 1000);
-                    }
-#endif
+        uint32_t waited = millis() - edgeTime;
+        _startButtonTimer(BUTTON_TIMER_CLICK, waited < _default_dbclick_time ? _default_dbclick_time - waited : 0);
 /* release event process */
         _process_release();
     }
@@ -92,31 +158,19 @@ void GenericButton::_processHandler() {
 
 
 void GenericButton::_process_press() {
-    for (auto &cb: _callbacks) {
-        if (cb.event == BUTTON_EVENT_IDLE || cb.event == BUTTON_EVENT_RELEASED) {
-            // reset idle callback
-            cb.excuted = false;
-        } else if (cb.event == BUTTON_EVENT_PRESSED) {
-            _execCallback(&cb);
-        } else if (cb.event == BUTTON_EVENT_STATE_CHANGE) {
-            cb.excuted = false; // reset state change callback
-            _execCallback(&cb);
-        }
-    }
+    _resetEvent(BUTTON_EVENT_IDLE);
+    _resetEvent(BUTTON_EVENT_RELEASED);
+    _execEvent(BUTTON_EVENT_PRESSED);
+    _resetEvent(BUTTON_EVENT_STATE_CHANGE);
+    _execEvent(BUTTON_EVENT_STATE_CHANGE);
 }
 
 
 void GenericButton::_process_release() {
-    for (auto &cb: _callbacks) {
-        if (cb.event == BUTTON_EVENT_PRESSED) {
-            cb.excuted = false; // reset pressed callback
-        } else if (cb.event == BUTTON_EVENT_RELEASED) {
-            _execCallback(&cb);
-        } else if (cb.event == BUTTON_EVENT_STATE_CHANGE) {
-            cb.excuted = false; // reset state change callback
-            _execCallback(&cb);
-        }
-    }
+    _resetEvent(BUTTON_EVENT_PRESSED);
+    _execEvent(BUTTON_EVENT_RELEASED);
+    _resetEvent(BUTTON_EVENT_STATE_CHANGE);
+    _execEvent(BUTTON_EVENT_STATE_CHANGE);
 }
 
 
@@ -129,25 +183,17 @@ void GenericButton::_process_click() {
         return;
     }
     GI_DEBUG_PRINTF("[Button][%d][%lu] Click count: %d\n", _pin, millis(), _click_count);
-    for (auto &cb: _callbacks) {
-        switch (_click_count) {
-            case 1:
-                if (cb.event == BUTTON_EVENT_CLICK || (cb.event == BUTTON_EVENT_CLICK_COUNT && cb.param == 1)) {
-                    _execCallback(&cb);
-                }
-                break;
-            case 2:
-                if (cb.event == BUTTON_EVENT_DOUBLE_CLICK || (cb.event == BUTTON_EVENT_CLICK_COUNT && cb.param == 2)) {
-                    _execCallback(&cb);
-                }
-                break;
-            default:
-                if (cb.event == BUTTON_EVENT_CLICK_COUNT && cb.param == _click_count) {
-                    _execCallback(&cb);
-                }
-                break;
-        }
+    switch (_click_count) {
+        case 1:
+            _execEvent(BUTTON_EVENT_CLICK);
+            break;
+        case 2:
+            _execEvent(BUTTON_EVENT_DOUBLE_CLICK);
+            break;
+        default:
+            break;
     }
+    _execClickCount(_click_count);
     _click_count = 0;
 }
 
@@ -156,18 +202,13 @@ void GenericButton::_process_idle() {
     if (_last_release_time == 0) return;
     _state = BUTTON_STATE_IDLE;
     GI_DEBUG_PRINTF("[Button][%d][%lu] Idle\n", _pin, millis());
-    for (auto &cb: _callbacks) {
-        switch (cb.event) {
-            case BUTTON_EVENT_IDLE:
-                _execCallback(&cb);
-                break;
-            case BUTTON_EVENT_STATE_CHANGE:
-                cb.excuted = false; // reset state change callback
-                _execCallback(&cb);
-                break;
-            default:
-                cb.excuted = false; // reset other callbacks
-                break;
+    _execEvent(BUTTON_EVENT_IDLE);
+    _resetEvent(BUTTON_EVENT_STATE_CHANGE);
+    _execEvent(BUTTON_EVENT_STATE_CHANGE);
+    /* reset the other events */
+    for (uint8_t event = 0; event < BUTTON_EVENT_COUNT; event++) {
+        if (event != BUTTON_EVENT_IDLE && event != BUTTON_EVENT_STATE_CHANGE) {
+            _resetEvent((generic_button_event_t) event);
         }
     }
     _last_release_time = 0;
@@ -180,12 +221,15 @@ void GenericButton::_process_hold() {
     if (_last_press_time == 0) return;
     uint32_t hold_time = millis() - _last_press_time;
     GI_DEBUG_PRINTF("[Button][%d][%lu] Hold time: %lu ms\n", _pin, millis(), hold_time);
-    for (auto &cb: _callbacks) {
-        if (cb.excuted) continue;
-        if (cb.event == BUTTON_EVENT_LONG_CLICK && hold_time >= _default_hold_time) {
-            _execCallback(&cb);
-        } else if (cb.event == BUTTON_EVENT_PRESS_HOLD && hold_time >= cb.param) {
-            _execCallback(&cb);
-        }
+    if (hold_time >= _default_hold_time) {
+        _execEvent(BUTTON_EVENT_LONG_CLICK);
+    }
+    /* sorted by hold time: start at the first unfired listener, stop at the first one not reached */
+    generic_button_bucket_t &bucket = _buckets[BUTTON_EVENT_PRESS_HOLD];
+    uint32_t unfired = ~bucket.fired;
+    if (unfired == 0) return;
+    for (uint8_t i = __builtin_ctz(unfired); i < bucket.count; i++) {
+        if (_listener(bucket, i).param > hold_time) break;
+        _execListener(bucket, i);
     }
 }
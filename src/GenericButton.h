@@ -3,7 +3,6 @@
 
 #include "DeviceLibTypes.h"
 #include "GenericInput.h"
-#include <vector>
 
 enum generic_button_event_t
 {
@@ -25,19 +24,59 @@ enum generic_button_state_t
     BUTTON_STATE_RELEASED
 };
 
+enum generic_button_timer_t
+{
+    BUTTON_TIMER_HOLD = 0,
+    BUTTON_TIMER_CLICK,
+    BUTTON_TIMER_IDLE
+};
+
+#define BUTTON_EVENT_COUNT (BUTTON_EVENT_STATE_CHANGE + 1)
+
+/* Listeners per event. Limited by the width of the fired bitmask */
+#ifndef BUTTON_MAX_LISTENERS
+#define BUTTON_MAX_LISTENERS 32
+#endif
+
+static_assert(BUTTON_MAX_LISTENERS <= 32, "BUTTON_MAX_LISTENERS is limited by the 32-bit fired mask");
+
+/* Listeners stored inline in the button (every event together), more are allocated in blocks of this size */
+#ifndef BUTTON_INLINE_LISTENERS
+#define BUTTON_INLINE_LISTENERS 8
+#endif
+
 struct generic_button_cb_t
 {
-    generic_button_event_t event;
+    generic_button_event_t event = BUTTON_EVENT_IDLE;
     devlib_callback_t callback;
     uint32_t param{};
-    bool excuted = false;
     generic_button_cb_t() = default;
-    generic_button_cb_t(generic_button_event_t evt, std::function<void()> cb, uint32_t p = 0, bool schedule = true)
-        : event(evt), param(p), excuted(false) {
-            callback.fn = std::move(cb);
-            callback.schedule = schedule;
+    generic_button_cb_t(generic_button_event_t evt, devlib_function_t cb, uint32_t p = 0, bool schedule = true,
+                        const char *tag = nullptr)
+        : event(evt), param(p) {
+            callback.assign(std::move(cb), schedule, tag);
         }
 };
+
+/**
+ * @brief Listeners registered past the inline ones, chained in registration order
+ */
+struct generic_button_block_t
+{
+    generic_button_cb_t listeners[BUTTON_INLINE_LISTENERS];
+    generic_button_block_t *next = nullptr;
+};
+
+/**
+ * @brief Listeners of one event, as slots of the listener pool of the button.
+ * CLICK_COUNT listeners are sorted by count, PRESS_HOLD by hold time
+ */
+struct generic_button_bucket_t
+{
+    uint8_t order[BUTTON_MAX_LISTENERS]{}; // pool slot of the i-th listener
+    uint8_t count = 0;
+    uint32_t fired = 0; // bit i: the i-th listener ran since the last reset
+};
  
 
 class GenericButton : public GenericInput {
@@ -69,6 +108,14 @@ public:
 
 #endif
 
+    ~GenericButton() {
+        while (_blocks != nullptr) {
+            generic_button_block_t *next = _blocks->next;
+            delete _blocks;
+            _blocks = next;
+        }
+    }
+
     /**
      * @brief Get the State object
      * 
@@ -146,7 +193,6 @@ public:
                 _pin, 2 * _default_dbclick_time);
         }
         _default_hold_time = time;
-        _autoAdjustTickTime();
     }
 
     /**
@@ -168,8 +214,8 @@ public:
      * @param cb 
      */
     [[deprecated("Use onRelease instead")]]
-    void onInactive(std::function<void()> cb, bool schedule = true) override {
-        onRelease(std::move(cb), schedule);
+    void onInactive(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) override {
+        onRelease(std::move(cb), schedule, tag);
     }
 
     /**
@@ -179,8 +225,8 @@ public:
      * @param cb 
      */
     [[deprecated("Use onPress instead")]]
-    void onActive(std::function<void()> cb, bool schedule = true) override {
-        onClick(std::move(cb), schedule);
+    void onActive(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) override {
+        onClick(std::move(cb), schedule, tag);
     }
 
     /**
@@ -190,20 +236,19 @@ public:
      * @param cb 
      * @param param if the event is BUTTON_EVENT_CLICK_COUNT or BUTTON_EVENT_PRESS_HOLD,
      * this parameter will be used to specify the count of clicks or hold time in milliseconds.
+     * @param schedule
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "b4.onClick"
      */
-    void onEvent(generic_button_event_t event, std::function<void()> cb, uint32_t param = 0, bool schedule = true) {
-        generic_button_cb_t listener(event, std::move(cb), param, schedule);
-        _callbacks.push_back(std::move(listener));
-        _init();
-    }
+    void onEvent(generic_button_event_t event, devlib_function_t cb, uint32_t param = 0, bool schedule = true,
+                 const char *tag = nullptr);
 
     /**
      * @brief The callback function will be executed when the button state is changed. (Pressed, Released, Idle)
      * 
      * @param cb 
      */
-    void onChange(std::function<void()> cb, bool schedule = true) override {
-        onEvent(BUTTON_EVENT_STATE_CHANGE, std::move(cb), 0, schedule);
+    void onChange(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) override {
+        onEvent(BUTTON_EVENT_STATE_CHANGE, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -211,8 +256,8 @@ public:
      * 
      * @param cb 
      */
-    void onPress(std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_PRESSED, std::move(cb), 0, schedule);
+    void onPress(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_PRESSED, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -220,8 +265,8 @@ public:
      * 
      * @param cb 
      */
-    void onRelease(std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_RELEASED, std::move(cb), 0, schedule);
+    void onRelease(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_RELEASED, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -229,8 +274,8 @@ public:
      * 
      * @param cb 
      */
-    void onIdle(std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_IDLE, std::move(cb), 0, schedule);
+    void onIdle(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_IDLE, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -238,8 +283,8 @@ public:
      * 
      * @param cb 
      */
-    void onClick(std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_CLICK, std::move(cb), 0, schedule);
+    void onClick(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_CLICK, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -247,8 +292,8 @@ public:
      * 
      * @param cb 
      */
-    void onDoubleClick(std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_DOUBLE_CLICK, std::move(cb), 0, schedule);
+    void onDoubleClick(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_DOUBLE_CLICK, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -256,8 +301,8 @@ public:
      * 
      * @param cb 
      */
-    void onLongClick(std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_LONG_CLICK, std::move(cb), 0, schedule);
+    void onLongClick(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_LONG_CLICK, std::move(cb), 0, schedule, tag);
     }
 
     /**
@@ -266,8 +311,8 @@ public:
      * @param count
      * @param cb 
      */
-    void onClickCount(uint8_t count, std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_CLICK_COUNT, std::move(cb), count, schedule);
+    void onClickCount(uint8_t count, devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_CLICK_COUNT, std::move(cb), count, schedule, tag);
     }
 
     /**
@@ -276,9 +321,8 @@ public:
      * @param hold_time in milliseconds
      * @param cb 
      */
-    void onPressHold(uint32_t hold_time, std::function<void()> cb, bool schedule = true) {
-        onEvent(BUTTON_EVENT_PRESS_HOLD, std::move(cb), hold_time, schedule);
-        _autoAdjustTickTime();
+    void onPressHold(uint32_t hold_time, devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        onEvent(BUTTON_EVENT_PRESS_HOLD, std::move(cb), hold_time, schedule, tag);
     }
 
 protected:
@@ -286,50 +330,71 @@ protected:
     uint32_t _default_dbclick_time = 300;
     uint32_t _default_idle_time = 500;
     uint32_t _default_hold_time = 3000;
-    uint32_t _hold_time_tick = _default_hold_time; // how often to check hold time in milliseconds
     uint32_t _last_press_time = 0;
     uint32_t _last_release_time = 0;
     uint8_t _click_count = 0;
-    std::vector<generic_button_cb_t> _callbacks;
-#if defined(ESP32)
-    esp_timer_handle_t _btnTimer = nullptr;
-
-    struct btn_timer_args_t {
-        GenericButton *button;
-        std::function<void()> callback;
-    } _btnTimerArg;
-
-    static void _espTimerCallback(void* arg) {
-        if (arg) {
-            auto cb = static_cast<btn_timer_args_t*>(arg)->callback;
-            if (cb) cb();
-        }
+    // a listener never moves once registered: a scheduled callback points into the pool
+    generic_button_cb_t _listeners[BUTTON_INLINE_LISTENERS];
+    generic_button_block_t *_blocks = nullptr;
+    uint8_t _listenerCount = 0;
+    generic_button_bucket_t _buckets[BUTTON_EVENT_COUNT];
+    generic_button_timer_t _btnTimerType = BUTTON_TIMER_HOLD;
+    timer_node_t _btnTimer{_onButtonTimer, this};
+
+    /**
+     * @brief Button timer handler. Runs the hold, click or idle process depending on _btnTimerType
+     * @param arg GenericButton object
+     */
+    static void _onButtonTimer(void *arg);
+
+    /**
+     * @brief Start the button timer
+     */
+    void _startButtonTimer(generic_button_timer_t type, uint32_t ms) {
+        _btnTimerType = type;
+        GPIO_Timer.arm(&_btnTimer, ms);
     }
 
-    void _init() override {
-        if (_isInitialized) return;
-        _btnTimerArg.button = this;
-        _btnTimerArg.callback = nullptr;
-        esp_timer_create_args_t timerArgs = {
-            .callback = &_espTimerCallback,
-            .arg = &_btnTimerArg,
-            .name = String("gbtn" + String(_pin)).c_str(),
-        };
-        esp_err_t err = esp_timer_create(&timerArgs, &_btnTimer);
-        if (err != ESP_OK) {
-            GI_DEBUG_PRINTF("[Button][%d] Failed to create button timer: %s\n", _pin, esp_err_to_name(err));
-        }
-        GenericInput::_init();
+    void _autoAdjustIdleTime();
+
+    /**
+     * @brief Arm the hold timer at the next hold time a listener waits for (LONG_CLICK or PRESS_HOLD)
+     * @param after only hold times past it are considered
+     */
+    void _armHoldTimer(uint32_t after);
+
+    /**
+     * @brief Listener of a pool slot, inline or in a block
+     */
+    generic_button_cb_t &_slot(uint8_t slot);
+
+    generic_button_cb_t &_listener(const generic_button_bucket_t &bucket, uint8_t i) {
+        return _slot(bucket.order[i]);
     }
-#endif
 
-    static uint32_t _gcd(uint32_t a, uint32_t b);
+    /**
+     * @brief Run the listener i of a bucket unless it already ran since the last reset
+     */
+    void _execListener(generic_button_bucket_t &bucket, uint8_t i);
 
-    void _autoAdjustIdleTime();
+    /**
+     * @brief Run every listener of an event that did not run since the last reset
+     */
+    void _execEvent(generic_button_event_t event) {
+        generic_button_bucket_t &bucket = _buckets[event];
+        for (uint8_t i = 0; i < bucket.count; i++) {
+            _execListener(bucket, i);
+        }
+    }
 
-    void _autoAdjustTickTime();
+    /**
+     * @brief Run the CLICK_COUNT listeners of a count
+     */
+    void _execClickCount(uint8_t count);
 
-    void _execCallback(generic_button_cb_t *cb);
+    void _resetEvent(generic_button_event_t event) {
+        _buckets[event].fired = 0;
+    }
 
     void _processHandler() override;
 
@@ -4,8 +4,14 @@
 
 #include "GenericInput.h"
 
+#if defined(ESP32)
+#include <soc/gpio_reg.h>
+#include <soc/soc_caps.h>
+#endif
+
 #if defined(USE_PCF)
-std::vector<pcf_irq_t> GenericInput::_pcfIRQ;
+pcf_irq_t GenericInput::_pcfIRQ[PCF_MAX_PORTS];
+uint8_t GenericInput::_pcfIRQCount = 0;
 #ifdef ESP32
 QueueHandle_t GenericInput::pcfIRQQueueHandle = nullptr;
 #endif // ESP32
@@ -36,31 +42,12 @@ GenericInput::GenericInput(PCF_TYPE &pcf, uint8_t pin, uint8_t mode, bool active
 
 
 bool GenericInput::attachInterrupt(uint8_t mode) {
-#if defined(ESP32)
-    // Create timer for debounce
-    esp_timer_create_args_t timerArgs = {
-        .callback = reinterpret_cast<esp_timer_cb_t>(_debounceHandler),
-        .arg = this,
-        .name = String("gidt" + String(_pin)).c_str(),
-    };
-    esp_err_t err = esp_timer_create(&timerArgs, &_timer);
-    if (err != ESP_OK) {
-        Serial.printf("[Err][Create timer] Failed to create timer for pin[%d]\n", _pin);
-        return false;
-    }
-#endif
 #if defined(USE_PCF)
     if (_pcf != nullptr) {
-        for (auto &pcfIRQ: _pcfIRQ) {
-            if (pcfIRQ.pcf == _pcf) {
-                pcfIRQ.inputs.push_back(this);
-                return true;
-            }
-        }
-        pcf_irq_t pcfIRQ;
-        pcfIRQ.pcf = _pcf;
-        pcfIRQ.inputs.push_back(this);
-        _pcfIRQ.push_back(pcfIRQ);
+        pcf_irq_t *pcfIRQ = _findPCFIRQ(_pcf, true);
+        if (pcfIRQ == nullptr || _pin >= PCF_PORT_PINS) return false;
+        pcfIRQ->inputs[_pin] = this;
+        _pcfIRQEntry = pcfIRQ;
         return true;
     }
 #endif
@@ -82,7 +69,7 @@ bool GenericInput::attachInterrupt(PCF_TYPE *pcf, uint8_t boardPin) {
 #ifdef ESP32
     /* init queue */
     if (pcfIRQQueueHandle == nullptr) {
-        pcfIRQQueueHandle = xQueueCreate(5, sizeof(pcf_irq_t *));
+        pcfIRQQueueHandle = xQueueCreate(5, sizeof(pcf_irq_event_t));
         if (pcfIRQQueueHandle == nullptr) {
             Serial.println("[Err][GenericInput::PCF] Failed to create queue");
             return false;
@@ -91,21 +78,14 @@ bool GenericInput::attachInterrupt(PCF_TYPE *pcf, uint8_t boardPin) {
 #endif
 
     /* Find pcf */
-    pcf_irq_t *_attached = nullptr;
-    for (auto &pcfIRQ: _pcfIRQ) {
-        if (pcfIRQ.pcf == pcf) {
-            _attached = &pcfIRQ;
-//                pcfIRQ.attachedPin = boardPin;
-            break;
-        }
-    }
+    pcf_irq_t *_attached = _findPCFIRQ(pcf, true);
     if (_attached == nullptr) {
-        pcf_irq_t pcfIRQ;
-        pcfIRQ.pcf = pcf;
-        //        pcfIRQ.attachedPin = boardPin;
-        _pcfIRQ.push_back(pcfIRQ);
-        _attached = &_pcfIRQ.back();
+        Serial.println("[Err][GenericInput::PCF] Too many expanders");
+        return false;
     }
+    /* seed the port value, every interrupt then reads the port once */
+    _attached->port = PCFPort::get(pcf);
+    _attached->attached = _attached->port != nullptr && _attached->port->read(_attached->value);
     pinMode(boardPin, INPUT_PULLUP);
     // ::detachInterrupt(digitalPinToInterrupt(boardPin));
     ::attachInterruptArg(boardPin, _pcfIRQHandler, _attached, FALLING);
@@ -116,34 +96,19 @@ bool GenericInput::attachInterrupt(PCF_TYPE *pcf, uint8_t boardPin) {
 
 
 void GenericInput::detachInterrupt() {
+    GPIO_Timer.cancel(&_debounceTimer);
+    _leadingPhase = LEADING_IDLE;
 #if defined(USE_PCF)
     if (_pcf != nullptr) {
-        if (!_pcfIRQ.empty()) {
-            for (auto &pcfIRQ: _pcfIRQ) {
-                if (pcfIRQ.pcf == _pcf && !pcfIRQ.inputs.empty()) {
-                    for (auto it = pcfIRQ.inputs.begin(); it != pcfIRQ.inputs.end(); ++it) {
-                        if (*it == this) {
-                            pcfIRQ.inputs.erase(it);
-                            break;
-                        }
-                    }
-                    // @TODO detach interrupt if no more pins
-                    return;
-                }
-            }
+        if (_pcfIRQEntry != nullptr && _pin < PCF_PORT_PINS && _pcfIRQEntry->inputs[_pin] == this) {
+            _pcfIRQEntry->inputs[_pin] = nullptr;
+            // @TODO detach interrupt if no more pins
         }
+        _pcfIRQEntry = nullptr;
         return;
     }
 #endif
     ::detachInterrupt(digitalPinToInterrupt(_pin));
-#if defined(ESP32)
-    // delete timer
-    if (_timer != nullptr) {
-        esp_timer_stop(_timer);
-        esp_timer_delete(_timer);
-        _timer = nullptr;
-    }
-#endif
 } // detachInterrupt
 
 
@@ -151,7 +116,7 @@ void GenericInput::detachInterrupt() {
 void GenericInput::_init() {
     if (_isInitialized) return;
     _isInitialized = true;
-    attachInterrupt(CHANGE);
+    if (!_scanned) attachInterrupt(CHANGE);
 }
 
 
@@ -160,53 +125,126 @@ void GenericInput::_init() {
 
 IRAM_ATTR void GenericInput::_irqHandler(void *arg) {
     auto *self = (GenericInput *) arg;
-#if defined(ESP32)
-    if (self->_timer != nullptr) {
-        esp_timer_stop(self->_timer);
-        esp_timer_start_once(self->_timer, self->_debounceTime * 1000);
-    }
-#elif defined(ESP8266)
-    self->_ticker.detach();
-    if (self->_debounceTime > 0) {
-        self->_ticker.once_ms(self->_debounceTime, _debounceHandler, self);
-    } else {
-        _debounceHandler(self);
-    }
+    uint32_t now = micros();
+    bool level = digitalRead(self->_pin);
+    self->_pushEdge(level, now);
+#if defined(USE_INPUT_TRACE)
+    GI_Trace.record(self->_pin, level, now);
 #endif
+    if (self->_debounceMode == INPUT_DEBOUNCE_LEADING) {
+        // report on the next timer tick, edges are ignored during the lockout
+        if (self->_leadingEdge(level)) GPIO_Timer.arm(&self->_debounceTimer, 0);
+        return;
+    }
+    // restart debounce, a debounce time of 0 is processed on the next timer tick
+    GPIO_Timer.arm(&self->_debounceTimer, self->_debounceTime);
 }
 
 
-void GenericInput::_debounceHandler(GenericInput *pInput) {
+void GenericInput::_debounceHandler(void *arg) {
+    auto *pInput = static_cast<GenericInput *>(arg);
     if (pInput == nullptr) {
         GI_DEBUG_PRINTF("[Err][Debounce] pInput is null\n");
         return;
     }
+    if (pInput->_debounceMode == INPUT_DEBOUNCE_LEADING) {
+        pInput->_leadingHandler();
+        return;
+    }
     pInput->_processHandler();
 }
 
 
+TIMER_ISR_ATTR bool GenericInput::_debounceSample(void *arg) {
+    auto *self = static_cast<GenericInput *>(arg);
+#if defined(USE_PCF)
+    if (self->_pcf != nullptr) return true; // I2C, read by the handler
+#endif
+    // the lockout end of the leading mode always needs the handler
+    if (self->_debounceMode == INPUT_DEBOUNCE_LEADING) return true;
+#if defined(ESP32)
+    // input registers, digitalRead() is not guaranteed to be in IRAM
+    uint8_t pin = self->_pin;
+#if SOC_GPIO_PIN_COUNT > 32
+    if (pin >= 32) return ((REG_READ(GPIO_IN1_REG) >> (pin - 32)) & 1) != self->_lastState;
+#endif
+    return ((REG_READ(GPIO_IN_REG) >> (pin & 31)) & 1) != self->_lastState;
+#else
+    return digitalRead(self->_pin) != self->_lastState;
+#endif
+}
+
+
+void GenericInput::_leadingHandler() {
+    if (_leadingPhase == LEADING_LOCKOUT) {
+        // end of the lockout: unlock first so an edge from now on starts a new report
+        _leadingPhase = LEADING_IDLE;
+        bool level = _read(true);
+        if (level == _lastState || !_leadingEdge(level)) return;
+        // changed during the lockout (short pulse)
+    }
+    if (_leadingPhase != LEADING_REPORT) return;
+    _processHandler();
+    _leadingPhase = LEADING_LOCKOUT;
+    GPIO_Timer.arm(&_debounceTimer, _debounceTime);
+}
+
+
 void GenericInput::_processHandler() {
     GI_DEBUG_PRINTF("[Debounce] pin[%d] state[%d]\n", _pin, _lastState);
-    bool currentState = _read(true);
+    bool currentState = _sample();
     if (currentState == _lastState)
         return;
     GI_DEBUG_PRINTF("\t -> pin[%d] %s\n", _pin, currentState == _activeState ? "ACTIVE" : "INACTIVE");
     _lastState = currentState;
+    _stateTime = _settledEdgeTime(currentState);
+#if defined(USE_INPUT_TRACE)
+    GI_Trace.event(_traceSource(), currentState == _activeState ? INPUT_TRACE_EVENT_ACTIVE : INPUT_TRACE_EVENT_INACTIVE);
+#endif
     if (currentState == _activeState) {
         GI_DEBUG_PRINTF("[Callback][%d] Start ActiveCB\n", _pin);
-        _execCallback(_onActiveCB);
+        _execKeyedCallback(_onActiveCB, SCHEDULE_KIND_EDGE);
         GI_DEBUG_PRINTF("[Callback][%d] End ActiveCB\n", _pin);
     } else {
         GI_DEBUG_PRINTF("[Callback][%d] Start InactiveCB\n", _pin);
-        _execCallback(_onInactiveCB);
+        _execKeyedCallback(_onInactiveCB, SCHEDULE_KIND_EDGE);
         GI_DEBUG_PRINTF("[Callback][%d] End InactiveCB\n", _pin);
     }
     GI_DEBUG_PRINTF("[Callback][%d] Start ChangeCB\n", _pin);
-    _execCallback(_onChangeCB);
+    _execKeyedCallback(_onChangeCB, SCHEDULE_KIND_CHANGE);
     GI_DEBUG_PRINTF("[Callback][%d] End ChangeCB\n", _pin);
 }
 
 
+uint32_t GenericInput::_settledEdgeTime(bool level) const {
+    uint32_t now = micros();
+    uint32_t count = _edgeCount;
+    uint32_t n = count < GI_EDGE_RING ? count : GI_EDGE_RING;
+    for (uint32_t i = 1; i <= n; i++) {
+        uint32_t edge = _edges[(count - i) & (GI_EDGE_RING - 1)];
+        uint32_t time = edge & ~1UL;
+        if (now - time >= now - _stateTime) break; // older than the previous state change
+        if ((edge & 1) == level) return time;
+    }
+    return now;
+}
+
+
+#if defined(USE_INPUT_TRACE)
+
+uint8_t GenericInput::_traceSource() const {
+#if defined(USE_PCF)
+    if (_pcf != nullptr) {
+        pcf_irq_t *pcfIRQ = _findPCFIRQ(_pcf, false);
+        if (pcfIRQ != nullptr) return INPUT_TRACE_PCF_SOURCE + (pcfIRQ - _pcfIRQ) * PCF_PORT_PINS + _pin;
+    }
+#endif
+    return _pin;
+}
+
+#endif // USE_INPUT_TRACE
+
+
 
 
 /* ================ PCF ISR ================ */
@@ -214,52 +252,89 @@ void GenericInput::_processHandler() {
 
 IRAM_ATTR void GenericInput::_pcfIRQHandler(void *arg) {
     auto *pcfIRQ = (pcf_irq_t *) arg;
+    if (pcfIRQ == nullptr) return;
+    pcf_irq_event_t event = {pcfIRQ, (uint32_t) micros()};
 #if defined(ESP32)
-    if (pcfIRQ && pcfIRQQueueHandle) {
+    if (pcfIRQQueueHandle) {
         BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(pcfIRQQueueHandle, &pcfIRQ, &xHigherPriorityTaskWoken);
+        xQueueSendFromISR(pcfIRQQueueHandle, &event, &xHigherPriorityTaskWoken);
         if (xHigherPriorityTaskWoken) {
             portYIELD_FROM_ISR();
         }
     }
-#elif defined(ESP8266)
+#else
+    // I2C is not usable from the ISR, the port is read on the next scheduler run
+    GPIO_Scheduler.addSchedule([event]() { _processPCFIRQ(event.irq, event.timeUs); });
+#endif // ESP32
+}
+
+
+pcf_irq_t *GenericInput::_findPCFIRQ(PCF_TYPE *pcf, bool create) {
+    for (uint8_t i = 0; i < _pcfIRQCount; i++) {
+        if (_pcfIRQ[i].pcf == pcf) return &_pcfIRQ[i];
+    }
+    if (!create || _pcfIRQCount >= PCF_MAX_PORTS) return nullptr;
+    pcf_irq_t *pcfIRQ = &_pcfIRQ[_pcfIRQCount++];
+    pcfIRQ->pcf = pcf;
+    return pcfIRQ;
+}
+
 
+void GenericInput::_processPCFIRQ(pcf_irq_t *pcfIRQ, uint32_t irqTime) {
     GI_DEBUG_PRINTF("PCF IRQ [0x%02x]\n", pcfIRQ->pcf->getAddress());
-    for (auto &input: pcfIRQ->inputs) {
-        GI_DEBUG_PRINTF("\t -> pin[%d] %s\n", input->_pin, input->_read(true) == input->_activeState ? "ACTIVE" : "INACTIVE");
-        if (input->_lastState == input->_read(true))
+    uint16_t changed;
+    if (pcfIRQ->attached) {
+        /* one port read, only the changed pins are processed */
+        uint16_t value;
+        if (!pcfIRQ->port->read(value)) return;
+        changed = value ^ pcfIRQ->value;
+        pcfIRQ->value = value;
+#if defined(USE_INPUT_TRACE)
+        uint8_t source = INPUT_TRACE_PCF_SOURCE + (pcfIRQ - _pcfIRQ) * PCF_PORT_PINS;
+        for (uint16_t bits = changed; bits; bits &= bits - 1) {
+            uint8_t pin = __builtin_ctz(bits);
+            GI_Trace.record(source + pin, (value >> pin) & 1, irqTime);
+        }
+#endif
+    } else {
+        changed = 0xFFFF; // no port: every input reads its own pin
+    }
+    while (changed) {
+        uint8_t pin = __builtin_ctz(changed);
+        changed &= changed - 1;
+        if (pin >= PCF_PORT_PINS) break;
+        GenericInput *input = pcfIRQ->inputs[pin];
+        if (input == nullptr) continue;
+        bool level = input->_read(true);
+        if (pcfIRQ->attached || input->_lastState != level) {
+            input->_pushEdge(level, irqTime);
+        }
+        if (input->_lastState == level)
             continue;
-        if (input->_debounceTime > 0) {
-            GI_DEBUG_PRINTF("[Debounce][%d] Start debounce\n", input->_pin);
-            input->_ticker.detach();
-            input->_ticker.once_ms(input->_debounceTime, _debounceHandler, input);
+        GI_DEBUG_PRINTF("\t -> pin[%d] changed\n", pin);
+#if defined(USE_INPUT_TRACE)
+        if (!pcfIRQ->attached) {
+            GI_Trace.record(INPUT_TRACE_PCF_SOURCE + (pcfIRQ - _pcfIRQ) * PCF_PORT_PINS + pin, level, irqTime);
+        }
+#endif
+        if (input->_debounceMode == INPUT_DEBOUNCE_LEADING) {
+            // not in an ISR: report right away
+            if (input->_leadingEdge(level)) input->_leadingHandler();
+        } else if (input->_debounceTime > 0) {
+            GPIO_Timer.arm(&input->_debounceTimer, input->_debounceTime);
         } else {
             _debounceHandler(input);
         }
     }
-
-#endif // ESP8266
 }
 
 
 #if defined(ESP32)
 void GenericInput::processPCFIRQ() {
-    pcf_irq_t *pcfIRQ = nullptr;
-    while (xQueueReceive(pcfIRQQueueHandle, &pcfIRQ, 0) == pdTRUE) {
-        if (pcfIRQ == nullptr) continue;
-        for (auto &input: pcfIRQ->inputs) {
-            if (input->_lastState == input->_read(true))
-                continue;
-            if (input->_debounceTime > 0) {
-                if (input->_timer != nullptr) {
-                    esp_timer_stop(input->_timer);
-                    esp_timer_start_once(input->_timer, input->_debounceTime * 1000);
-                }
-            } else {
-                _debounceHandler(input);
-            }
-        }
+    pcf_irq_event_t event;
+    while (xQueueReceive(pcfIRQQueueHandle, &event, 0) == pdTRUE) {
+        _processPCFIRQ(event.irq, event.timeUs);
     }
 }
 #endif // ESP32
-#endif // USE_PCF
\ No newline at end of file
+#endif // USE_PCF
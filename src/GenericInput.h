@@ -17,21 +17,32 @@
 #endif // DEBUG
 
 
-#if defined(ESP32)
-
-#include <freertos/queue.h>
-#include <esp_timer.h>
 #include "GPIO_helper.h"
 
-#elif defined(ESP8266)
+/* Define USE_INPUT_TRACE to record the raw edges and report the input events, see InputTrace.h */
+#if defined(USE_INPUT_TRACE)
+#include "InputTrace.h"
+#endif
+
+/* Edges kept per input with their ISR timestamp, power of 2 */
+#ifndef GI_EDGE_RING
+#define GI_EDGE_RING 8
+#endif
+
+static_assert((GI_EDGE_RING & (GI_EDGE_RING - 1)) == 0, "GI_EDGE_RING must be a power of 2");
 
-#include <Ticker.h>
-#include <functional>
+#if defined(ESP32)
+
+#include <freertos/queue.h>
 
 #endif
 
 class GenericInput;
 
+class InputScanner;
+
+class MatrixKeypad;
+
 #if __has_include_next(<PCF8574.h>)
 
 #include <PCF8574.h>
@@ -45,16 +56,37 @@ class GenericInput;
 
 #if defined(USE_PCF)
 
-#include <vector>
+#include "PCFPort.h"
+
+#define PCF_PORT_PINS (PCF_PORT_BYTES * 8)
 
 struct pcf_irq_t {
     PCF_TYPE *pcf = nullptr;
-    std::vector<GenericInput *> inputs = {};
-//    int16_t attachedPin = -1;
+    PCFPort *port = nullptr;
+    GenericInput *inputs[PCF_PORT_PINS] = {}; // pin -> input
+    uint16_t value = 0xFFFF;                   // last value read from the port
+    bool attached = false;                     // INT attached, value follows the port
+};
+
+/* one interrupt of an expander, queued with its own timestamp */
+struct pcf_irq_event_t {
+    pcf_irq_t *irq;
+    uint32_t timeUs; // micros() in the ISR
 };
+
+#if defined(USE_INPUT_TRACE)
+static_assert(PCF_MAX_PORTS * PCF_PORT_PINS <= 128 - INPUT_TRACE_PCF_SOURCE, "Too many expander pins for the trace sources");
+#endif
 #endif // USE_PCF
 
+enum generic_input_debounce_t {
+    INPUT_DEBOUNCE_TRAILING = 0, // report once the pin is stable for the debounce time
+    INPUT_DEBOUNCE_LEADING       // report the first edge, then ignore the pin for the debounce time
+};
+
 class GenericInput {
+    friend class ::InputScanner;
+    friend class ::MatrixKeypad;
 
 public:
     GenericInput() = default;
@@ -125,6 +157,24 @@ public:
         return _debounceTime;
     }
 
+    /**
+     * @brief Set the debounce mode
+     * @param mode INPUT_DEBOUNCE_TRAILING (default): the change is reported when the pin has been stable
+     *             for the debounce time.
+     *             INPUT_DEBOUNCE_LEADING: the first edge is reported on the next timer tick, the pin is then
+     *             locked out for the debounce time and read again at its end. For contacts without
+     *             spikes (buttons, switches), no debounce latency.
+     */
+    void setDebounceMode(generic_input_debounce_t mode) {
+        _debounceMode = mode;
+        _leadingPhase = LEADING_IDLE;
+        _init();
+    }
+
+    generic_input_debounce_t getDebounceMode() const {
+        return _debounceMode;
+    }
+
     /**
      * @brief Set the active state
      * @param activeState
@@ -179,9 +229,10 @@ public:
      * @param cb
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    virtual void onChange(std::function<void()> cb, bool schedule = true) {
-        _onChangeCB.assign(cb, schedule);
+    virtual void onChange(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        _onChangeCB.assign(std::move(cb), schedule, tag);
         _init();
     }
 
@@ -190,9 +241,10 @@ public:
      * @param cb
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    virtual void onActive(std::function<void()> cb, bool schedule = true) {
-        _onActiveCB.assign(cb, schedule);
+    virtual void onActive(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        _onActiveCB.assign(std::move(cb), schedule, tag);
         _init();
     }
 
@@ -201,9 +253,10 @@ public:
      * @param cb
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    virtual void onInactive(std::function<void()> cb, bool schedule = true) {
-        _onInactiveCB.assign(cb, schedule);
+    virtual void onInactive(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        _onInactiveCB.assign(std::move(cb), schedule, tag);
         _init();
     }
 
@@ -246,11 +299,20 @@ protected:
     uint32_t _debounceTime;
     String _activeStateStr = "ACTIVE";
     String _inactiveStateStr = "NONE";
-#if defined(ESP32)
-    esp_timer_handle_t _timer = nullptr;
-#elif defined(ESP8266)
-    Ticker _ticker;
-#endif
+    timer_node_t _debounceTimer{_debounceHandler, this, _debounceSample};
+    volatile uint32_t _edges[GI_EDGE_RING] = {}; // micros() of the edge, bit 0 is the level
+    volatile uint32_t _edgeCount = 0;
+    uint32_t _stateTime = 0; // micros() of the edge that settled _lastState
+    generic_input_debounce_t _debounceMode = INPUT_DEBOUNCE_TRAILING;
+    enum : uint8_t {
+        LEADING_IDLE = 0, // waiting for an edge
+        LEADING_REPORT,   // edge to report on the next timer tick
+        LEADING_LOCKOUT   // reported, the pin is ignored until the timer expires
+    };
+    volatile uint8_t _leadingPhase = LEADING_IDLE;
+    volatile bool _leadingLevel = false; // level of the edge to report
+    bool _scanned = false;               // debounced by an InputScanner or MatrixKeypad instead of the interrupt
+    bool _scanLevel = false;             // debounced level from the scanner
     // Callbacks
     devlib_callback_t _onChangeCB;
     devlib_callback_t _onActiveCB;
@@ -265,11 +327,20 @@ protected:
     virtual void _execCallback(devlib_callback_t &cb) {
         if (!cb.isValid()) return;
         if (cb.schedule) {
-#if defined(ESP32)
-            GPIO_Scheduler.addSchedule(cb.fn);
-#elif defined(ESP8266)
-            schedule_function(cb.fn);
-#endif
+            GPIO_Scheduler.addSchedule(&devlib_callback_t::invoke, &cb, SCHEDULE_LANE_CRITICAL, cb.tag);
+        } else {
+            cb();
+        }
+    }
+
+    /**
+     * @brief Schedule a state callback keyed by (input, kind): a pending one of the same kind is replaced
+     */
+    void _execKeyedCallback(devlib_callback_t &cb, schedule_kind_t kind) {
+        if (!cb.isValid()) return;
+        if (cb.schedule) {
+            GPIO_Scheduler.addKeyedSchedule(this, kind, devlib_function_t(&devlib_callback_t::invoke, &cb),
+                                            SCHEDULE_LANE_CRITICAL, cb.tag);
         } else {
             cb();
         }
@@ -277,15 +348,56 @@ protected:
 
 #if defined(USE_PCF)
     PCF_TYPE *_pcf = nullptr;
-    static std::vector<pcf_irq_t> _pcfIRQ; // for PCF interrupt
+    pcf_irq_t *_pcfIRQEntry = nullptr;
+    static pcf_irq_t _pcfIRQ[PCF_MAX_PORTS]; // for PCF interrupt, fixed so the ISR argument stays valid
+    static uint8_t _pcfIRQCount;
 #ifdef ESP32
     static QueueHandle_t pcfIRQQueueHandle; // for PCF interrupt
 #endif
 
     IRAM_ATTR void static _pcfIRQHandler(void *arg);
 
+    /**
+     * @brief Find the interrupt entry of an expander
+     * @param pcf
+     * @param create add it if not found
+     * @return nullptr if not found or full
+     */
+    static pcf_irq_t *_findPCFIRQ(PCF_TYPE *pcf, bool create);
+
+    /**
+     * @brief Read the port once and route the changed pins to their inputs
+     * @param pcfIRQ expander
+     * @param irqTime micros() of the interrupt, the time of the edges
+     */
+    static void _processPCFIRQ(pcf_irq_t *pcfIRQ, uint32_t irqTime);
+
 #endif // USE_PCF
 
+    /**
+     * @brief Store an edge with its timestamp. Called from the ISR
+     */
+    inline void IRAM_ATTR _pushEdge(bool level, uint32_t timeUs) {
+        uint32_t count = _edgeCount;
+        _edges[count & (GI_EDGE_RING - 1)] = (timeUs & ~1UL) | level;
+        _edgeCount = count + 1;
+    }
+
+    /**
+     * @brief Time of the settled edge: the newest edge to `level` since the previous state change
+     * @return micros() of the edge, now if the ring has none
+     */
+    uint32_t _settledEdgeTime(bool level) const;
+
+#if defined(USE_INPUT_TRACE)
+
+    /**
+     * @brief Source of the input in the trace: the pin, or INPUT_TRACE_PCF_SOURCE + expander pin
+     */
+    uint8_t _traceSource() const;
+
+#endif // USE_INPUT_TRACE
+
     /**
      * @brief Interrupt handler
      * @param arg GenericInput object
@@ -294,9 +406,16 @@ protected:
 
     /**
      * @brief Handler after debounce time
-     * @param pInput GenericInput object
+     * @param arg GenericInput object
      */
-    void static _debounceHandler(GenericInput *pInput);
+    void static _debounceHandler(void *arg);
+
+    /**
+     * @brief Pin sample at the end of the debounce time, in the timer ISR (DEVLIB_TIMER_ISR)
+     * @param arg GenericInput object
+     * @return false if the pin settled back to the reported level: the handler is not needed
+     */
+    TIMER_ISR_ATTR static bool _debounceSample(void *arg);
 
     /**
      * @brief Input process handler
@@ -304,6 +423,31 @@ protected:
      */
     virtual void _processHandler();
 
+    /**
+     * @brief Leading-edge debounce: report the edge, then re-validate the pin at the end of the lockout
+     */
+    void _leadingHandler();
+
+    /**
+     * @brief Start a leading-edge report unless the input is locked out
+     * @return true if the edge starts a report
+     */
+    inline bool IRAM_ATTR _leadingEdge(bool level) {
+        if (_leadingPhase != LEADING_IDLE) return false;
+        _leadingLevel = level;
+        _leadingPhase = LEADING_REPORT;
+        return true;
+    }
+
+    /**
+     * @brief Level to process: the scanner level, the edge being reported in leading-edge mode,
+     * the pin otherwise
+     */
+    bool _sample() {
+        if (_scanned) return _scanLevel;
+        return _leadingPhase == LEADING_REPORT ? _leadingLevel : _read(true);
+    }
+
     /**
  * @brief pinMode wrapper
  */
@@ -321,8 +465,13 @@ protected:
      * @brief digitalRead wrapper
      */
     uint8_t _read(bool forceRead = false) {
+        if (_scanned) return _scanLevel;
 #if defined(USE_PCF)
         if (_pcf != nullptr) {
+            if (_pcfIRQEntry != nullptr && _pcfIRQEntry->attached) {
+                // kept up to date by the expander interrupt
+                return (_pcfIRQEntry->value >> _pin) & 1;
+            }
             return _pcf->digitalRead(_pin, forceRead);
         }
 #endif
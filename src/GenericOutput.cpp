@@ -8,13 +8,7 @@ void GenericOutput::on(bool force)
         GO_PRINTF("[%s] START ON DELAY: %d ms\n", _pinKey.c_str(), _pOnDelay);
         if (_pState != stdGenericOutput::WAIT_FOR_ON || force) {
             _pState = stdGenericOutput::WAIT_FOR_ON;
-#if defined(ESP8266)
-            _ticker.detach();
-            _ticker.once_ms(_pOnDelay, _onTick, this);
-#elif defined(ESP32)
-            esp_timer_stop(_timer);
-            esp_timer_start_once(_timer, _pOnDelay * 1000);
-#endif
+            _rearmTimer(_pOnDelay);
             return;
         }
     }
@@ -24,13 +18,7 @@ void GenericOutput::on(bool force)
     if (_autoOffEnabled && _duration > 0)
     {
         GO_PRINTF("[%s] START AUTO OFF: %d ms\n", _pinKey.c_str(), _duration);
-#if defined(ESP8266)
-        _ticker.detach();
-        _ticker.once_ms(_duration, _onTick, this);
-#elif defined(ESP32)
-        esp_timer_stop(_timer);
-        esp_timer_start_once(_timer, _duration * 1000);
-#endif
+        _rearmTimer(_duration);
     }
 }
 
@@ -41,13 +29,7 @@ void GenericOutput::on(uint32_t onDelay, uint32_t duration, bool force) {
         GO_PRINTF("[%s] START ON DELAY: %d ms\n", _pinKey.c_str(), onDelay);
         if (_pState != stdGenericOutput::WAIT_FOR_ON || force) {
             _pState = stdGenericOutput::WAIT_FOR_ON;
-#if defined(ESP8266)
-            _ticker.detach();
-            _ticker.once_ms(onDelay, _onTick, this);
-#elif defined(ESP32)
-            esp_timer_stop(_timer);
-            esp_timer_start_once(_timer, onDelay * 1000);
-#endif
+            _rearmTimer(onDelay);
             return;
         }
     }
@@ -56,18 +38,10 @@ void GenericOutput::on(uint32_t onDelay, uint32_t duration, bool force) {
     // auto off, timer will be reset if already running
     if (_autoOffEnabled)
     {
-#if defined(ESP8266)
-        _ticker.detach();
-#elif defined(ESP32)
-        esp_timer_stop(_timer);
-#endif
+        _cancelTimer();
         if (_duration > 0) {
             GO_PRINTF("[%s] START AUTO OFF: %d ms\n", _pinKey.c_str(), duration);
-#if defined(ESP8266)
-            _ticker.once_ms(duration, _onTick, this);
-#elif defined(ESP32)
-            esp_timer_start_once(_timer, duration * 1000);
-#endif
+            _rearmTimer(duration);
         }
     }
 }
@@ -79,12 +53,9 @@ void GenericOutput::onPercentage(uint8_t percentage, bool force) {
 
 void GenericOutput::off(bool force)
 {
-#if defined(ESP8266)
-    _ticker.detach();
-#elif defined(ESP32)
-    esp_timer_stop(_timer);
-#endif
+    // cancelled after the switch: a pin edge its isr stage already wrote is written over
     _off_function(force);
+    _cancelTimer();
 }
 
 void GenericOutput::setPowerOnDelay(uint32_t delay)
@@ -117,4 +88,22 @@ uint32_t GenericOutput::getDuration() const
 
 uint32_t GenericOutput::getPowerOnDelay() const {
     return _pOnDelay;
-}
\ No newline at end of file
+}
+
+void GenericOutput::_rearmTimer(uint32_t ms) {
+    if (GPIO_Timer.arm(&_timer, ms)) _writePin();
+}
+
+void GenericOutput::_cancelTimer() {
+    if (GPIO_Timer.cancel(&_timer)) _writePin();
+}
+
+TIMER_ISR_ATTR bool GenericOutput::_onTickPin(void *arg) {
+    auto *pOutput = static_cast<GenericOutput *>(arg);
+    if (pOutput->_pState == stdGenericOutput::WAIT_FOR_ON) {
+        pOutput->_writePinFromTimer(true);
+    } else if (pOutput->_pState == stdGenericOutput::ON && pOutput->_autoOffEnabled) {
+        pOutput->_writePinFromTimer(false);
+    }
+    return true;
+}
@@ -3,12 +3,6 @@
 
 #include "GenericOutputBase.h"
 
-#if defined(ESP8266)
-#include <Ticker.h>
-#elif defined(ESP32)
-#include <esp_timer.h>
-#endif
-
 namespace stdGenericOutput {
 
     typedef enum {
@@ -65,19 +59,8 @@ public:
 
 #endif
 
-    void begin() override {
-        GenericOutputBase::begin();
-#ifdef ES32
-        esp_timer_create_args_t timerArgs = {
-                .callback = reinterpret_cast<esp_timer_cb_t>(_onTick),
-                .arg = this,
-                .name = String("got" + String(_pin)).c_str(),
-        };
-        esp_err_t err = esp_timer_create(&timerArgs, &_timer);
-        if (err != ESP_OK) {
-            Serial.printf("[GenericOutput][Err][Create timer] Failed to create timer for pin[%d]\n", _pin);
-        }
-#endif
+    ~GenericOutput() {
+        GPIO_Timer.cancel(&_timer);
     }
 
     /**
@@ -183,9 +166,10 @@ public:
      * @param onAutoOff callback function
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    void onAutoOff(std::function<void()> onAutoOff, bool schedule = true) {
-        _onAutoOff.assign(onAutoOff, schedule);
+    void onAutoOff(devlib_function_t onAutoOff, bool schedule = true, const char *tag = nullptr) {
+        _onAutoOff.assign(std::move(onAutoOff), schedule, tag);
     }
 
 protected:
@@ -194,11 +178,7 @@ protected:
     uint32_t _duration = 0;
     uint32_t _pOnDelay = 0;
     devlib_callback_t _onAutoOff;
-#if defined(ESP8266)
-    Ticker _ticker;
-#elif defined(ESP32)
-    esp_timer_handle_t _timer = nullptr;
-#endif
+    timer_node_t _timer{_onTick, this, _onTickPin};
 
     virtual void _on_function(bool force) {
         GO_PRINTF("[%s] excuting _on_function\n", _pinKey.c_str());
@@ -212,11 +192,30 @@ protected:
         GenericOutputBase::off(force);
     }
 
+    void _groupApply(bool state) override {
+        // switched at once by the group: no on delay, the auto off still applies
+        _pState = state ? stdGenericOutput::ON : stdGenericOutput::OFF;
+        if (state && _autoOffEnabled && _duration > 0) {
+            _rearmTimer(_duration);
+        } else {
+            _cancelTimer();
+        }
+    }
+
     /**
-     * @brief Ticker callback handler
-     * @param pOutput
+     * @brief Arm or cancel the timer. If its isr stage already wrote the pin edge (DEVLIB_TIMER_ISR)
+     * and the task stage is dropped, the pin is written back from the state
      */
-    static void _onTick(GenericOutput *pOutput) {
+    void _rearmTimer(uint32_t ms);
+
+    void _cancelTimer();
+
+    /**
+     * @brief Timer callback handler
+     * @param arg GenericOutput object
+     */
+    static void _onTick(void *arg) {
+        auto *pOutput = static_cast<GenericOutput *>(arg);
         if (pOutput->_pState == stdGenericOutput::WAIT_FOR_ON) {
             GO_PRINTF("[%s] ON DELAY FINISHED\n", pOutput->_pinKey.c_str());
             pOutput->_pState = stdGenericOutput::ON;
@@ -227,6 +226,13 @@ protected:
             pOutput->_execCallback(pOutput->_onAutoOff);
         }
     }
+
+    /**
+     * @brief Pin edge of the on delay or auto off, in the timer ISR (DEVLIB_TIMER_ISR).
+     * _onTick follows in the task for the state, the store and the callbacks
+     * @param arg GenericOutput object
+     */
+    TIMER_ISR_ATTR static bool _onTickPin(void *arg);
 };
 
 
@@ -1,7 +1,44 @@
 #include "GenericOutputBase.h"
 
+#if defined(ESP32)
+#include <soc/gpio_reg.h>
+#include <soc/soc_caps.h>
+#endif
+
 #if defined(USE_LAST_STATE)
 ENVFile GO_FS("/gpiols");
+
+#if defined(USE_STATE_JOURNAL)
+#if defined(ESP32) || defined(ESP8266)
+static FileJournalStorage _journalStorage(GO_JOURNAL_PATH);
+#else
+static StdioJournalStorage _journalStorage(GO_JOURNAL_PATH);
+#endif
+StateJournal GO_Journal(_journalStorage);
+
+static bool _writeLastState(const String &key, bool state) {
+    return GO_Journal.set(key, state);
+}
+
+static bool _readLastState(const String &key) {
+    return GO_Journal.getBool(key, false);
+}
+#else
+static bool _writeLastState(const String &key, bool state) {
+    GO_FS.set(key, state);
+    return true;
+}
+
+static bool _readLastState(const String &key) {
+    return GO_FS.getBool(key, false);
+}
+#endif // USE_STATE_JOURNAL
+
+LastStateCache GO_LastState(_writeLastState);
+
+#if defined(USE_RTC_STATE)
+RTCStateMirror GO_RTCState;
+#endif // USE_RTC_STATE
 #endif // USE_LAST_STATE
 
 
@@ -20,9 +57,11 @@ stdGenericOutput::GenericOutputBase::GenericOutputBase(uint8_t pin, bool activeS
     _state = false;
     _pinKey = "p" + String(_pin);
     pinMode(_pin, OUTPUT);
+#if defined(USE_LAST_STATE)
+    _restoreWarmState();
+#endif
     // Set last state
-    devlib_callback_t lastStateCB([this](){ begin(); });
-    _execCallback(lastStateCB);
+    GPIO_Scheduler.addSchedule([this]() { begin(); });
 }
 
 #if defined(USE_PCF)
@@ -34,10 +73,17 @@ stdGenericOutput::GenericOutputBase::GenericOutputBase(PCF_TYPE& pcf, uint8_t pi
     // @WARNING: getAddress is not a member of PCF8574
     _pinKey = "p" + String(pcf.getAddress()) + String(_pin);
     _pcf = &pcf;
-    pcf.pinMode(_pin, OUTPUT);
+    _pcfPort = PCFPort::get(&pcf);
+    if (_pcfPort != nullptr) {
+        _pcfPort->pinMode(_pin, OUTPUT); // sent with the first commit of the port
+    } else {
+        pcf.pinMode(_pin, OUTPUT);
+    }
+#if defined(USE_LAST_STATE)
+    _restoreWarmState();
+#endif
     // Set last state
-    devlib_callback_t lastStateCB([this](){ begin(); });
-    _execCallback(lastStateCB);
+    GPIO_Scheduler.addSchedule([this]() { begin(); });
 }
 #endif
 
@@ -47,9 +93,14 @@ stdGenericOutput::GenericOutputBase::~GenericOutputBase() {
     auto it = std::find(attachedDBDevices.begin(), attachedDBDevices.end(), this);
     if (it != attachedDBDevices.end()) {
         attachedDBDevices.erase(it);
+        GO_DBDispatcher.invalidate();
     }
 #endif // USE_FBRTDB && FBRTDB_LIB_TYPE == 1
 
+#if defined(USE_LAST_STATE)
+    GO_LastState.remove(_lastStateIndex);
+#endif // USE_LAST_STATE
+
     _onPowerOn.fn = nullptr;
     _onPowerOff.fn = nullptr;
     _onPowerChanged.fn = nullptr;
@@ -73,7 +124,18 @@ void stdGenericOutput::GenericOutputBase::begin() {
             break;
         case START_UP_LAST_STATE:
 #if defined(USE_LAST_STATE)
-            setState(GO_FS.getBool(_pinKey, false), true);
+        {
+#if defined(USE_RTC_STATE)
+            if (_warmRestored) {
+                // newer than the flash store, which may have missed the last unflushed changes
+                setState(_state, true);
+                break;
+            }
+#endif
+            bool lastState = _readLastState(_pinKey);
+            GO_LastState.setStored(_lastStateSlot(), lastState);
+            setState(lastState, true);
+        }
 #endif
             break;
         default:
@@ -84,22 +146,35 @@ void stdGenericOutput::GenericOutputBase::begin() {
 void stdGenericOutput::GenericOutputBase::_execCallback(devlib_callback_t &callback) {
     if (!callback.isValid()) return;
     if (callback.schedule) {
-#if defined(ESP32)
-        GPIO_Scheduler.addSchedule(callback.fn);
-#else
-        schedule_function(callback.fn);
-#endif
+        GPIO_Scheduler.addSchedule(&devlib_callback_t::invoke, &callback, SCHEDULE_LANE_CRITICAL, callback.tag);
+    } else {
+        callback();
+    }
+}
+
+void stdGenericOutput::GenericOutputBase::_execKeyedCallback(devlib_callback_t &callback, schedule_kind_t kind) {
+    if (!callback.isValid()) return;
+    if (callback.schedule) {
+        GPIO_Scheduler.addKeyedSchedule(this, kind, devlib_function_t(&devlib_callback_t::invoke, &callback),
+                                        SCHEDULE_LANE_CRITICAL, callback.tag);
     } else {
         callback();
     }
 }
 
 void stdGenericOutput::GenericOutputBase::_write() {
+    _writePin();
+    _storeState();
+}
+
+void stdGenericOutput::GenericOutputBase::_writePin() {
     /* GPIO set */
     if (_pin != UINT8_MAX) {
 #if defined(USE_PCF)
         GO_PRINTF("[%s] write: %d\n", _pinKey.c_str(), _state ? _activeState : !_activeState);
-        if (_pcf != nullptr) {
+        if (_pcfPort != nullptr) {
+            _pcfPort->digitalWrite(_pin, _state ? _activeState : !_activeState);
+        } else if (_pcf != nullptr) {
             _pcf->digitalWrite(_pin, _state ? _activeState : !_activeState);
         } else {
             digitalWrite(_pin, _state ? _activeState : !_activeState);
@@ -109,29 +184,90 @@ void stdGenericOutput::GenericOutputBase::_write() {
         digitalWrite(_pin, _state ? _activeState : !_activeState);
 #endif
     }
+}
+
+TIMER_ISR_ATTR void stdGenericOutput::GenericOutputBase::_writePinFromTimer(bool state) {
+    if (_pin == UINT8_MAX) return;
+#if defined(USE_PCF)
+    if (_pcfPort != nullptr || _pcf != nullptr) return;
+#endif
+    bool high = state ? _activeState : !_activeState;
+#if defined(ESP32)
+    // set/clear registers, digitalWrite() is not guaranteed to be in IRAM
+#if SOC_GPIO_PIN_COUNT > 32
+    if (_pin >= 32) {
+        REG_WRITE(high ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, 1UL << (_pin - 32));
+        return;
+    }
+#endif
+    REG_WRITE(high ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, 1UL << (_pin & 31));
+#else
+    digitalWrite(_pin, high);
+#endif
+}
+
+void stdGenericOutput::GenericOutputBase::_storeState() {
     /* Store last state */
 #if defined(USE_LAST_STATE)
-    GO_FS.set(_pinKey, _state);
+    int16_t slot = _lastStateSlot();
+    if (slot >= 0) {
+        GO_LastState.set(slot, _state);
+    } else {
+        _writeLastState(_pinKey, _state);
+    }
+#if defined(USE_RTC_STATE)
+    GO_RTCState.set(_rtcStateIndex, _state);
+#endif
 #endif
     /* Update state to cloud */
 #if defined(USE_FBRTDB)
-#if defined(ESP32)
-    GPIO_Scheduler.addSchedule([this]() { _updateDB(); });
-#else
-    schedule_function([this]() {
-        const_cast<GenericOutputBase*>(this)->_updateDB();
-    });
-#endif
+    _updateDB();
 #endif // USE_FBRTDB
 }
 
+void stdGenericOutput::GenericOutputBase::_groupCallbacks(bool state) {
+    (state ? _onPowerOn : _onPowerOff)();
+    _onPowerChanged();
+}
+
+#if defined(USE_LAST_STATE)
+int16_t stdGenericOutput::GenericOutputBase::_lastStateSlot() {
+    if (_lastStateIndex < 0) {
+        _lastStateIndex = GO_LastState.add(&_pinKey);
+    }
+    return _lastStateIndex;
+}
+
+void stdGenericOutput::GenericOutputBase::_restoreWarmState() {
+#if defined(USE_RTC_STATE)
+    if (_startUpState != START_UP_LAST_STATE) return;
+    _rtcStateIndex = GO_RTCState.add(_pinKey);
+    bool state;
+    if (!GO_RTCState.restore(_rtcStateIndex, state)) return;
+    GO_PRINTF("[%s] warm restore: %s\n", _pinKey.c_str(), state ? "ON" : "OFF");
+    _state = state;
+    _warmRestored = true;
+#if defined(USE_PCF)
+    if (_pcfPort != nullptr) {
+        _pcfPort->digitalWrite(_pin, _state ? _activeState : !_activeState); // only the shadow
+        return;
+    }
+    if (_pcf != nullptr) return; // written by begin(), the expander may not be ready yet
+#endif
+    if (_pin != UINT8_MAX) {
+        digitalWrite(_pin, _state ? _activeState : !_activeState);
+    }
+#endif // USE_RTC_STATE
+}
+#endif // USE_LAST_STATE
+
 void stdGenericOutput::GenericOutputBase::on(bool force) {
     if (_state && !force) return;
     GO_PRINTF("[%s] ON\n", _pinKey.c_str());
     _state = true;
     _write();
-    _execCallback(_onPowerOn);
-    _execCallback(_onPowerChanged);
+    _execKeyedCallback(_onPowerOn, SCHEDULE_KIND_EDGE);
+    _execKeyedCallback(_onPowerChanged, SCHEDULE_KIND_CHANGE);
 }
 
 void stdGenericOutput::GenericOutputBase::off(bool force) {
@@ -139,8 +275,8 @@ void stdGenericOutput::GenericOutputBase::off(bool force) {
     GO_PRINTF("[%s] OFF\n", _pinKey.c_str());
     _state = false;
     _write();
-    _execCallback(_onPowerOff);
-    _execCallback(_onPowerChanged);
+    _execKeyedCallback(_onPowerOff, SCHEDULE_KIND_EDGE);
+    _execKeyedCallback(_onPowerChanged, SCHEDULE_KIND_CHANGE);
 }
 
 void stdGenericOutput::GenericOutputBase::toggle() {
@@ -168,22 +304,13 @@ void stdGenericOutput::GenericOutputBase::setState(const String &state, bool for
 #if defined(USE_FBRTDB)
 
 void stdGenericOutput::GenericOutputBase::_updateDB() {
-    if (_flag_ignore_update_db) {
-        _flag_ignore_update_db = false;
-        return;
-    }
+    if (_flag_ignore_update_db) return; // the change came from the database
     if (_fbRTDBconfig == nullptr) {
         Serial.printf("[Err][Update] %s: DB config not found\n", _dbSubPath.c_str());
         return;
     }
-    if (_fbRTDBconfig->path.length() == 0) {
-        Serial.printf("[Err][Update] %s: DB path not found\n", _dbSubPath.c_str());
-        return;
-    }
-    Serial.printf("[Update] %s: %s\n", _dbSubPath.c_str(), getStateString().c_str());
-    FirebaseJson json;
-    json.set(_dbSubPath, _state);
-    Firebase.RTDB.updateNodeSilent(_fbRTDBconfig->fbdo, _fbRTDBconfig->path, &json);
+    _dbPending = true;
+    GO_DBBatch.schedule();
 }
 
 void stdGenericOutput::GenericOutputBase::attachDatabase(fbrtdb_config_t *dbconfig, String subPath) {
@@ -195,12 +322,16 @@ void stdGenericOutput::GenericOutputBase::attachDatabase(fbrtdb_config_t *dbconf
     if (std::find(attachedDBDevices.begin(), attachedDBDevices.end(), this) == attachedDBDevices.end()) {
         attachedDBDevices.push_back(this);
     }
+    GO_DBDispatcher.invalidate();
 #endif
 }
 
 void stdGenericOutput::GenericOutputBase::detachDatabase() {
     _fbRTDBconfig = nullptr;
     _dbSubPath = "";
+#if FBRTDB_LIB_TYPE == 1
+    GO_DBDispatcher.invalidate();
+#endif
 }
 
 void stdGenericOutput::GenericOutputBase::syncState(bool state) {
@@ -250,9 +381,9 @@ void stdGenericOutput::GenericOutputBase::attachESPNOW(const String& propName, E
                 off();
             } else if (value == "toggle") {
                 toggle();
-                schedule_function([this](){
+                GPIO_Scheduler.addSchedule([this](){
                     Node.sendSyncProp(_propName, getStateBoolString());
-                });
+                }, SCHEDULE_LANE_BACKGROUND);
             } else {
                 return false;
             }
@@ -288,14 +419,14 @@ String stdGenericOutput::GenericOutputBase::getStateString() const {
 
 /* =================== Callback =====================*/
 
-void stdGenericOutput::GenericOutputBase::onPowerOn(std::function<void()> onPowerOn, bool schedule) {
-    _onPowerOn.assign(onPowerOn, schedule);
+void stdGenericOutput::GenericOutputBase::onPowerOn(devlib_function_t onPowerOn, bool schedule, const char *tag) {
+    _onPowerOn.assign(std::move(onPowerOn), schedule, tag);
 }
 
-void stdGenericOutput::GenericOutputBase::onPowerOff(std::function<void()> onPowerOff, bool schedule) {
-    _onPowerOff.assign(onPowerOff, schedule);
+void stdGenericOutput::GenericOutputBase::onPowerOff(devlib_function_t onPowerOff, bool schedule, const char *tag) {
+    _onPowerOff.assign(std::move(onPowerOff), schedule, tag);
 }
 
-void stdGenericOutput::GenericOutputBase::onPowerChanged(std::function<void()> onPowerChanged, bool schedule) {
-    _onPowerChanged.assign(onPowerChanged, schedule);
+void stdGenericOutput::GenericOutputBase::onPowerChanged(devlib_function_t onPowerChanged, bool schedule, const char *tag) {
+    _onPowerChanged.assign(std::move(onPowerChanged), schedule, tag);
 }
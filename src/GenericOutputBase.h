@@ -22,7 +22,29 @@
 #if defined(USE_LAST_STATE)
 
 #include "ENVFile.h"
+#include "LastStateCache.h"
 extern ENVFile GO_FS;
+/* Write-behind cache in front of the store. Call GO_LastState.flush() before a reboot/OTA */
+extern LastStateCache GO_LastState;
+
+/* Define USE_STATE_JOURNAL to keep last states in an append-only binary journal instead of GO_FS */
+#if defined(USE_STATE_JOURNAL)
+#include "StateJournal.h"
+#ifndef GO_JOURNAL_PATH
+#define GO_JOURNAL_PATH "/gpiols.jnl"
+#endif
+extern StateJournal GO_Journal;
+#endif // USE_STATE_JOURNAL
+
+/* Mirror of the last states in RTC memory, applied by the constructors after a warm reset.
+ * Define NO_RTC_STATE to disable it */
+#if !defined(NO_RTC_STATE) && !defined(USE_RTC_STATE)
+#define USE_RTC_STATE
+#endif
+#if defined(USE_RTC_STATE)
+#include "RTCStateMirror.h"
+extern RTCStateMirror GO_RTCState;
+#endif // USE_RTC_STATE
 
 #endif // USE_LAST_STATE
 
@@ -35,6 +57,7 @@ extern ENVFile GO_FS;
 #define PCF_TYPE PCF8574
 #endif // USE_PCF
 #endif // __has_include_next(<PCF8574.h>)
+#include "PCFPort.h"
 
 
 /* ======== ESPNOW ======== */
@@ -64,6 +87,11 @@ namespace stdGenericOutput {
 
 #endif // USE_FBRTDB
 
+#if FBRTDB_LIB_TYPE == 1
+#include "FBRTDBBatch.h"
+#include "FBRTDBDispatcher.h"
+#endif
+
 #ifndef USE_TIMESTAMP
 #define USE_TIMESTAMP
 #endif // USE_TIMESTAMP
@@ -95,7 +123,14 @@ extern std::vector<stdGenericOutput::GenericOutputBase *> attachedDBDevices;
 
 
 
+class OutputGroup;
+
 class stdGenericOutput::GenericOutputBase {
+#if defined(USE_FBRTDB) && FBRTDB_LIB_TYPE == 1
+    friend class ::FBRTDBBatch;
+    friend class ::FBRTDBDispatcher;
+#endif
+    friend class ::OutputGroup;
 
 public:
 
@@ -214,8 +249,9 @@ public:
      * @param onPowerOn
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    void onPowerOn(std::function<void()> onPowerOn, bool schedule = true);
+    void onPowerOn(devlib_function_t onPowerOn, bool schedule = true, const char *tag = nullptr);
 
     /**
      * @brief Set callback function to be called when power is off
@@ -223,8 +259,9 @@ public:
      * @param onPowerOff
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    void onPowerOff(std::function<void()> onPowerOff, bool schedule = true);
+    void onPowerOff(devlib_function_t onPowerOff, bool schedule = true, const char *tag = nullptr);
 
     /**
      * @brief Set callback function to be called when power is changed
@@ -232,8 +269,9 @@ public:
      * @param onPowerChanged
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    void onPowerChanged(std::function<void()> onPowerChanged, bool schedule = true);
+    void onPowerChanged(devlib_function_t onPowerChanged, bool schedule = true, const char *tag = nullptr);
 
 
 #if defined(USE_FBRTDB)
@@ -260,6 +298,7 @@ public:
      * @brief Sync the state from the database to the device.
      *
      * Call this function in the stream callback. It will be parsed and set the state to the device.
+     * With many devices, call GO_DBDispatcher.dispatch(data, dbconfig) once instead, the event is only parsed once.
      * @param data FirebaseStream
      */
     void syncState(FirebaseStream *data, bool onlyProcessWithPutMethod = true);
@@ -284,6 +323,23 @@ protected:
 #ifdef USE_LAST_STATE
     String _pinKey = "";
     bool _flag_set_startup_state = false;
+    int16_t _lastStateIndex = -1;
+
+    /**
+     * @brief Register the device in GO_LastState
+     * @return index in the cache, -1 if the cache is full
+     */
+    int16_t _lastStateSlot();
+
+#if defined(USE_RTC_STATE)
+    int8_t _rtcStateIndex = -1;
+    bool _warmRestored = false;
+#endif // USE_RTC_STATE
+
+    /**
+     * @brief Apply the state kept in RTC memory across a warm reset. Called from the constructors
+     */
+    void _restoreWarmState();
 #endif // USE_LAST_STATE
 
     /**
@@ -292,8 +348,15 @@ protected:
      */
     static void _execCallback(devlib_callback_t &callback);
 
+    /**
+     * @brief Schedule a state callback keyed by (output, kind): a pending one of the same kind is
+     * replaced, so a burst of toggles runs the callbacks of the latest state once
+     */
+    void _execKeyedCallback(devlib_callback_t &callback, schedule_kind_t kind);
+
 #if defined(USE_PCF)
     PCF_TYPE* _pcf = nullptr;
+    PCFPort* _pcfPort = nullptr; // shadow register, nullptr falls back to _pcf
 #endif
 
 
@@ -301,7 +364,11 @@ protected:
     fbrtdb_config_t* _fbRTDBconfig = nullptr;
     String _dbSubPath = "";
     bool _flag_ignore_update_db = false;
+    volatile bool _dbPending = false;
 
+    /**
+     * @brief Queue the state for the next batched database update
+     */
     void _updateDB();
 #endif
 
@@ -313,9 +380,37 @@ protected:
 #endif
 
     /**
-     * @brief digitalWrite wrapper
+     * @brief Write the pin and store the state
      */
     void _write();
+
+    /**
+     * @brief digitalWrite wrapper
+     */
+    void _writePin();
+
+    /**
+     * @brief Write the level of a state to an on-chip pin from the timer ISR, the state is not changed.
+     * Expander pins are left to _writePin() (I2C)
+     */
+    TIMER_ISR_ATTR void _writePinFromTimer(bool state);
+
+    /**
+     * @brief Store the state (last state, RTC mirror) and queue the database update
+     */
+    void _storeState();
+
+    /**
+     * @brief Called by OutputGroup after it wrote a new state, for the state of subclasses (timers)
+     * @param state
+     */
+    virtual void _groupApply(bool /*state*/) {}
+
+    /**
+     * @brief Run the power callbacks for a state written by OutputGroup
+     * @param state
+     */
+    virtual void _groupCallbacks(bool state);
 };
 
 #endif // GENERIC_OUTPUT_BASE_H
\ No newline at end of file
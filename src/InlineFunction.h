@@ -0,0 +1,175 @@
+#ifndef INLINEFUNCTION_H
+#define INLINEFUNCTION_H
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Move-only `void()` callable stored in a fixed buffer of `Capacity` bytes.
+ *
+ * Unlike std::function it never allocates: callables larger than the buffer are rejected
+ * at compile time. A plain function pointer, or a function pointer plus a context pointer,
+ * are stored without any type erasure overhead.
+ *
+ * @tparam Capacity size of the inline buffer in bytes
+ */
+template<size_t Capacity>
+class InlineFunction {
+public:
+    typedef void (*plain_fn_t)();
+
+    typedef void (*context_fn_t)(void *);
+
+    static constexpr size_t capacity = Capacity < sizeof(void *) * 2 ? sizeof(void *) * 2 : Capacity;
+
+    InlineFunction() = default;
+
+    InlineFunction(std::nullptr_t) {}
+
+    /**
+     * @brief Wrap a function pointer taking a context argument
+     * @param fn
+     * @param context passed to fn on every call
+     */
+    InlineFunction(context_fn_t fn, void *context) {
+        if (fn == nullptr) return;
+        auto *target = reinterpret_cast<context_target_t *>(_storage);
+        target->fn = fn;
+        target->context = context;
+        _invoke = &_invokeContext;
+    }
+
+    /**
+     * @brief Wrap any callable that fits in the buffer (lambda, functor, function pointer, std::function)
+     */
+    template<typename F,
+            typename Fn = typename std::decay<F>::type,
+            typename = typename std::enable_if<!std::is_same<Fn, InlineFunction>::value>::type,
+            typename = decltype(std::declval<Fn &>()())>
+    InlineFunction(F &&f) {
+        static_assert(sizeof(Fn) <= capacity, "Callable is too large for InlineFunction, raise DEVLIB_CALLBACK_SIZE");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "Callable is over-aligned for InlineFunction");
+        if (_isNull(f)) return;
+        new(_storage) Fn(std::forward<F>(f));
+        _invoke = &_invokeTarget<Fn>;
+        _manage = _isTrivial<Fn>() ? nullptr : &_manageTarget<Fn>;
+    }
+
+    InlineFunction(InlineFunction &&other) noexcept {
+        _moveFrom(other);
+    }
+
+    InlineFunction &operator=(InlineFunction &&other) noexcept {
+        if (this != &other) {
+            reset();
+            _moveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineFunction &operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction &) = delete;
+
+    InlineFunction &operator=(const InlineFunction &) = delete;
+
+    ~InlineFunction() {
+        reset();
+    }
+
+    /**
+     * @brief Destroy the stored callable
+     */
+    void reset() {
+        if (_manage != nullptr) _manage(nullptr, _storage);
+        _invoke = nullptr;
+        _manage = nullptr;
+    }
+
+    explicit operator bool() const {
+        return _invoke != nullptr;
+    }
+
+    bool operator==(std::nullptr_t) const {
+        return _invoke == nullptr;
+    }
+
+    bool operator!=(std::nullptr_t) const {
+        return _invoke != nullptr;
+    }
+
+    void operator()() const {
+        if (_invoke != nullptr) _invoke(const_cast<unsigned char *>(_storage));
+    }
+
+private:
+    struct context_target_t {
+        context_fn_t fn;
+        void *context;
+    };
+
+    alignas(std::max_align_t) unsigned char _storage[capacity]{};
+    void (*_invoke)(void *) = nullptr;
+    // move (dst != nullptr) or destroy (dst == nullptr) the callable. nullptr when trivially copyable
+    void (*_manage)(void *dst, void *src) = nullptr;
+
+    template<typename Fn>
+    static constexpr bool _isTrivial() {
+        return std::is_trivially_copyable<Fn>::value && std::is_trivially_destructible<Fn>::value;
+    }
+
+    template<typename Fn>
+    static bool _isNull(const Fn &) {
+        return false;
+    }
+
+    template<typename R, typename... A>
+    static bool _isNull(R (*const &fn)(A...)) {
+        return fn == nullptr;
+    }
+
+    template<typename Sig>
+    static bool _isNull(const std::function<Sig> &fn) {
+        return fn == nullptr;
+    }
+
+    static void _invokeContext(void *storage) {
+        auto *target = static_cast<context_target_t *>(storage);
+        target->fn(target->context);
+    }
+
+    template<typename Fn>
+    static void _invokeTarget(void *storage) {
+        (*static_cast<Fn *>(storage))();
+    }
+
+    template<typename Fn>
+    static void _manageTarget(void *dst, void *src) {
+        auto *target = static_cast<Fn *>(src);
+        if (dst != nullptr) new(dst) Fn(std::move(*target));
+        target->~Fn();
+    }
+
+    void _moveFrom(InlineFunction &other) {
+        if (other._invoke == nullptr) return;
+        if (other._manage != nullptr) {
+            other._manage(_storage, other._storage);
+        } else {
+            memcpy(_storage, other._storage, capacity);
+        }
+        _invoke = other._invoke;
+        _manage = other._manage;
+        other._invoke = nullptr;
+        other._manage = nullptr;
+    }
+};
+
+
+#endif //INLINEFUNCTION_H
@@ -0,0 +1,117 @@
+#include "InputScanner.h"
+
+#if defined(ESP32)
+#include <soc/gpio_reg.h>
+#endif
+
+
+InputScanner::~InputScanner() {
+    end();
+    for (auto &input: _inputs) {
+        if (input != nullptr) remove(*input);
+    }
+}
+
+bool InputScanner::add(GenericInput &input) {
+#if defined(USE_PCF)
+    if (input._pcf != nullptr) {
+        Serial.println("[Err][InputScanner] Expander inputs can not be scanned");
+        return false;
+    }
+#endif
+    uint8_t pin = input._pin;
+    if (pin >= INPUT_SCAN_PINS) {
+        Serial.printf("[Err][InputScanner] Invalid pin %d\n", pin);
+        return false;
+    }
+    if (input._isInitialized && !input._scanned) input.detachInterrupt();
+    input._scanned = true;
+    input._scanLevel = input._lastState;
+
+    uint8_t word = pin / 32;
+    uint32_t bit = 1UL << (pin % 32);
+    _inputs[pin] = &input;
+    _mask[word] |= bit;
+    // start from the current level, counter idle
+    uint32_t level = input._lastState ? bit : 0;
+    _debounce[word].reset(bit, level);
+    _raw[word] = (_raw[word] & ~bit) | level;
+    return true;
+}
+
+void InputScanner::remove(GenericInput &input) {
+    uint8_t pin = input._pin;
+    if (pin >= INPUT_SCAN_PINS || _inputs[pin] != &input) return;
+    _inputs[pin] = nullptr;
+    _mask[pin / 32] &= ~(1UL << (pin % 32));
+    input._scanned = false;
+    if (input._isInitialized) input.attachInterrupt(CHANGE);
+}
+
+void InputScanner::begin() {
+    if (_running) return;
+    _running = true;
+    GPIO_Timer.arm(&_timer, _periodMs);
+}
+
+void InputScanner::end() {
+    _running = false;
+    GPIO_Timer.cancel(&_timer);
+}
+
+void InputScanner::scan() {
+    uint32_t now = micros();
+    for (uint8_t w = 0; w < INPUT_SCAN_WORDS; w++) {
+        if (_mask[w] == 0) continue;
+        uint32_t sample = readPins(w, _mask[w]);
+        uint32_t toggle = _debounce[w].update(sample) & _mask[w];
+
+#if defined(USE_INPUT_TRACE)
+        for (uint32_t bits = (sample ^ _raw[w]) & _mask[w]; bits; bits &= bits - 1) {
+            uint8_t bit = __builtin_ctz(bits);
+            GI_Trace.record(w * 32 + bit, (sample >> bit) & 1, now);
+        }
+#endif
+        _raw[w] = sample;
+
+        /* dispatch the changed pins only */
+        for (; toggle; toggle &= toggle - 1) {
+            uint8_t bit = __builtin_ctz(toggle);
+            GenericInput *input = _inputs[w * 32 + bit];
+            if (input == nullptr) continue;
+            bool level = (_debounce[w].state >> bit) & 1;
+            input->_scanLevel = level;
+            // the change started with the first of the equal samples
+            input->_pushEdge(level, now - (INPUT_SCAN_SAMPLES - 1) * _periodMs * 1000);
+            input->_processHandler();
+        }
+    }
+}
+
+void InputScanner::_scanTask(void *arg) {
+    auto *scanner = static_cast<InputScanner *>(arg);
+    if (!scanner->_running) return;
+    GPIO_Timer.arm(&scanner->_timer, scanner->_periodMs);
+    scanner->scan();
+}
+
+uint32_t InputScanner::readPins(uint8_t word, uint32_t mask) {
+#if defined(ESP32)
+    (void) mask;
+#if SOC_GPIO_PIN_COUNT > 32
+    if (word > 0) return REG_READ(GPIO_IN1_REG);
+#endif
+    return REG_READ(GPIO_IN_REG);
+#elif defined(ESP8266)
+    (void) word;
+    (void) mask;
+    return (GPI & 0xFFFF) | ((GP16I & 1) << 16);
+#else
+    uint32_t value = 0;
+    for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        uint8_t bit = __builtin_ctz(bits);
+        if (digitalRead(word * 32 + bit)) value |= 1UL << bit;
+    }
+    return value;
+#endif
+}
@@ -0,0 +1,163 @@
+#ifndef INPUTSCANNER_H
+#define INPUTSCANNER_H
+
+#include <Arduino.h>
+#include "GenericInput.h"
+
+#if defined(ESP32)
+#include <soc/soc_caps.h>
+#define INPUT_SCAN_PINS SOC_GPIO_PIN_COUNT
+#elif defined(ESP8266)
+#define INPUT_SCAN_PINS 17
+#else
+#define INPUT_SCAN_PINS DEVLIB_HOST_PINS
+#endif
+
+#define INPUT_SCAN_WORDS ((INPUT_SCAN_PINS + 31) / 32)
+
+/* Consecutive equal samples before a change is reported (2-bit vertical counter) */
+#define INPUT_SCAN_SAMPLES 4
+
+/* Default sampling period in milliseconds, the debounce time is INPUT_SCAN_SAMPLES periods */
+#ifndef INPUT_SCAN_PERIOD_MS
+#define INPUT_SCAN_PERIOD_MS 5
+#endif
+
+/**
+ * @brief 32 bits debounced in parallel with 2-bit vertical counters.
+ *
+ * Each bit has a counter of the samples that differ from its debounced state; an equal sample
+ * resets it. The state bit toggles when the counter wraps, after INPUT_SCAN_SAMPLES samples.
+ */
+struct vertical_debounce_t {
+    uint32_t state = 0;        // debounced levels
+    uint32_t ct0 = UINT32_MAX; // counter, bit 0 (all ones when idle)
+    uint32_t ct1 = UINT32_MAX; // counter, bit 1
+
+    /**
+     * @brief Add a sample
+     * @return bits whose debounced state changed
+     */
+    inline uint32_t update(uint32_t sample) {
+        uint32_t delta = state ^ sample;
+        ct0 = ~(ct0 & delta);
+        ct1 = ct0 ^ (ct1 & delta);
+        uint32_t toggle = delta & ct0 & ct1;
+        state ^= toggle;
+        return toggle;
+    }
+
+    /**
+     * @brief Set the state of some bits and stop their counters
+     */
+    void reset(uint32_t mask, uint32_t level) {
+        state = (state & ~mask) | (level & mask);
+        ct0 |= mask;
+        ct1 |= mask;
+    }
+
+    /**
+     * @brief true while a counter runs, i.e. a bit differs from its debounced state
+     */
+    bool busy() const {
+        return (ct0 & ct1) != UINT32_MAX;
+    }
+};
+
+/**
+ * @brief Polled debouncing of many on-chip inputs at once.
+ *
+ * Instead of one interrupt and one debounce timer per pin, a periodic timer reads the whole
+ * GPIO input registers (GPIO_IN/GPIO_IN1 on ESP32, GPI/GP16I on ESP8266) and debounces every pin
+ * in parallel with 2-bit vertical counters: a pin changes after INPUT_SCAN_SAMPLES equal samples.
+ * Only the changed bits are dispatched to their inputs. The cost per period is a few register
+ * reads and word operations, whatever the number of pins and however much they bounce.
+ *
+ * Inputs added to the scanner do not use their interrupt; their debounce time and mode are
+ * ignored. Expander (PCF) inputs are not supported, they have their own interrupt.
+ *
+ * Example:
+ * @code
+ * GenericButton buttons[24] = {...};
+ * InputScanner scanner;
+ *
+ * void setup() {
+ *     for (auto &button: buttons) scanner.add(button);
+ *     scanner.begin();
+ * }
+ * @endcode
+ */
+class InputScanner {
+public:
+    /**
+     * @param periodMs sampling period
+     */
+    explicit InputScanner(uint32_t periodMs = INPUT_SCAN_PERIOD_MS) : _periodMs(periodMs) {}
+
+    ~InputScanner();
+
+    /**
+     * @brief Scan an input instead of using its interrupt
+     * @return false for expander inputs or invalid pins
+     */
+    bool add(GenericInput &input);
+
+    /**
+     * @brief Stop scanning an input, it goes back to its interrupt
+     */
+    void remove(GenericInput &input);
+
+    /**
+     * @brief Start sampling
+     */
+    void begin();
+
+    /**
+     * @brief Stop sampling
+     */
+    void end();
+
+    /**
+     * @brief Set the sampling period
+     */
+    void setPeriod(uint32_t periodMs) {
+        _periodMs = periodMs > 0 ? periodMs : 1;
+    }
+
+    uint32_t getPeriod() const {
+        return _periodMs;
+    }
+
+    /**
+     * @brief Debounced level of every scanned pin, word w holds the pins 32*w..32*w+31
+     */
+    uint32_t getState(uint8_t word) const {
+        return word < INPUT_SCAN_WORDS ? _debounce[word].state & _mask[word] : 0;
+    }
+
+    /**
+     * @brief Take one sample and dispatch the debounced changes. Called by the timer
+     */
+    void scan();
+
+    /**
+     * @brief Input levels of a word of on-chip pins, one register read
+     * @param word pins 32*word..32*word+31
+     * @param mask pins needed, only read one by one on cores without register access
+     */
+    static uint32_t readPins(uint8_t word, uint32_t mask);
+
+private:
+    uint32_t _periodMs;
+    bool _running = false;
+    GenericInput *_inputs[INPUT_SCAN_PINS] = {};
+    uint32_t _mask[INPUT_SCAN_WORDS] = {}; // scanned pins
+    uint32_t _raw[INPUT_SCAN_WORDS] = {};  // last sample
+    vertical_debounce_t _debounce[INPUT_SCAN_WORDS];
+    timer_node_t _timer{_scanTask, this};
+
+    static void _scanTask(void *arg);
+};
+
+
+#endif //INPUTSCANNER_H
@@ -0,0 +1,83 @@
+#include "InputTrace.h"
+
+#if defined(USE_INPUT_TRACE)
+
+#include <algorithm>
+
+InputTrace GI_Trace;
+
+
+void InputTrace::start() {
+    _lock.enter();
+    _count = 0;
+    _dropped = 0;
+    _lastUs = micros();
+    _recording = true;
+    _lock.exit();
+}
+
+void IRAM_ATTR InputTrace::record(uint8_t source, bool level, uint32_t timeUs) {
+    if (!_recording) return;
+    _lock.enter();
+    // an edge stamped before the previous one (other core) is kept with a zero delta
+    uint32_t delta = (int32_t) (timeUs - _lastUs) > 0 ? timeUs - _lastUs : 0;
+    while (delta >= INPUT_TRACE_GAP_US && _count < INPUT_TRACE_RECORDS) {
+        _records[_count++] = INPUT_TRACE_GAP_US << 8;
+        _lastUs += INPUT_TRACE_GAP_US;
+        delta -= INPUT_TRACE_GAP_US;
+    }
+    if (_count < INPUT_TRACE_RECORDS) {
+        _records[_count++] = (delta << 8) | (level ? 0x80 : 0) | (source & 0x7F);
+        _lastUs += delta;
+    } else {
+        _dropped++;
+    }
+    _lock.exit();
+}
+
+size_t InputTrace::read(size_t offset, void *buf, size_t len) const {
+    input_trace_header_t header{INPUT_TRACE_MAGIC, INPUT_TRACE_VERSION, sizeof(uint32_t), (uint32_t) _count, _dropped};
+    auto *out = static_cast<uint8_t *>(buf);
+    size_t copied = 0;
+    if (offset < sizeof(header)) {
+        size_t n = std::min(len, sizeof(header) - offset);
+        memcpy(out, reinterpret_cast<const uint8_t *>(&header) + offset, n);
+        copied = n;
+        offset += n;
+    }
+    size_t end = size();
+    if (copied < len && offset < end) {
+        size_t n = std::min(len - copied, end - offset);
+        memcpy(out + copied, reinterpret_cast<const uint8_t *>(_records) + offset - sizeof(header), n);
+        copied += n;
+    }
+    return copied;
+}
+
+
+InputTraceReader::InputTraceReader(const void *data, size_t length) {
+    if (data == nullptr || length < sizeof(input_trace_header_t)) return;
+    memcpy(&_header, data, sizeof(_header));
+    if (_header.magic != INPUT_TRACE_MAGIC || _header.recordSize != sizeof(uint32_t)) return;
+    size_t available = (length - sizeof(_header)) / sizeof(uint32_t);
+    if (_header.count > available) _header.count = available; // truncated dump
+    _records = static_cast<const uint8_t *>(data) + sizeof(_header);
+    _valid = true;
+}
+
+bool InputTraceReader::next(input_trace_edge_t &edge) {
+    while (_valid && _index < _header.count) {
+        uint32_t record;
+        memcpy(&record, _records + _index++ * sizeof(uint32_t), sizeof(record));
+        uint32_t delta = record >> 8;
+        _timeUs += delta;
+        if (delta == INPUT_TRACE_GAP_US) continue;
+        edge.timeUs = _timeUs;
+        edge.source = record & 0x7F;
+        edge.level = (record & 0x80) != 0;
+        return true;
+    }
+    return false;
+}
+
+#endif // USE_INPUT_TRACE
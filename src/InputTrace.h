@@ -0,0 +1,204 @@
+#ifndef INPUTTRACE_H
+#define INPUTTRACE_H
+
+#include <Arduino.h>
+#include <cstddef>
+#include "CriticalSection.h"
+
+/* Edges kept by the recorder, 4 bytes each */
+#ifndef INPUT_TRACE_RECORDS
+#define INPUT_TRACE_RECORDS 1024
+#endif
+
+#define INPUT_TRACE_MAGIC 0x52544944UL // "DITR"
+#define INPUT_TRACE_VERSION 1
+
+/*
+ * Record word: [31..8] microseconds since the previous record, [7] level, [6..0] source.
+ * A record with the whole delta field set is a gap of INPUT_TRACE_GAP_US without an edge.
+ */
+#define INPUT_TRACE_GAP_US 0xFFFFFFUL
+
+/* Sources: on-chip pins are 0..63, expander pins follow */
+#define INPUT_TRACE_PCF_SOURCE 64
+
+/* Events reported by GenericInput, GenericButton events use their generic_button_event_t value */
+enum input_trace_event_t : uint8_t {
+    INPUT_TRACE_EVENT_ACTIVE = 0x80,
+    INPUT_TRACE_EVENT_INACTIVE,
+};
+
+struct input_trace_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t count;   // records, gaps included
+    uint32_t dropped; // edges lost because the recorder was full
+};
+
+struct input_trace_edge_t {
+    uint64_t timeUs; // since the start of the recording
+    uint8_t source;
+    bool level;
+};
+
+/**
+ * @brief Listener of the input events
+ * @param source pin or expander source of the input
+ * @param event input_trace_event_t or generic_button_event_t
+ * @param timeUs micros() when the callback was dispatched
+ */
+typedef void (*input_trace_listener_t)(uint8_t source, uint8_t event, uint32_t timeUs, void *arg);
+
+/**
+ * @brief Recorder of the raw input edges, for reproducing bounce and timing issues.
+ *
+ * GenericInput records every edge seen by its interrupt (or by the PCF interrupt) with its
+ * micros() timestamp, before any debouncing. The trace is a header followed by 4-byte
+ * delta-encoded records (little endian) and can be dumped with read() to a file or the serial
+ * port, then replayed against the state machines on the host (extras/host).
+ *
+ * The event listener reports every callback the inputs dispatch, so a replay can measure the
+ * latency from the last edge to each event.
+ *
+ * Enabled with USE_INPUT_TRACE.
+ *
+ * Example:
+ * @code
+ * GI_Trace.start();
+ * // ... press the buttons
+ * GI_Trace.stop();
+ * uint8_t buf[64];
+ * for (size_t offset = 0; offset < GI_Trace.size(); offset += sizeof(buf)) {
+ *     file.write(buf, GI_Trace.read(offset, buf, sizeof(buf)));
+ * }
+ * @endcode
+ */
+class InputTrace {
+public:
+    constexpr InputTrace() = default;
+
+    /**
+     * @brief Clear the trace and start recording
+     */
+    void start();
+
+    /**
+     * @brief Stop recording, the trace is kept
+     */
+    void stop() {
+        _recording = false;
+    }
+
+    bool isRecording() const {
+        return _recording;
+    }
+
+    /**
+     * @brief Record an edge. Safe from ISR
+     * @param source pin, or INPUT_TRACE_PCF_SOURCE + expander pin
+     * @param level
+     * @param timeUs micros() of the edge
+     */
+    void IRAM_ATTR record(uint8_t source, bool level, uint32_t timeUs);
+
+    /**
+     * @brief Number of records
+     */
+    size_t count() const {
+        return _count;
+    }
+
+    /**
+     * @brief Edges lost since start()
+     */
+    uint32_t dropped() const {
+        return _dropped;
+    }
+
+    /**
+     * @brief Size of the serialized trace in bytes
+     */
+    size_t size() const {
+        return sizeof(input_trace_header_t) + _count * sizeof(uint32_t);
+    }
+
+    /**
+     * @brief Copy a part of the serialized trace
+     * @param offset byte offset in the trace
+     * @param buf
+     * @param len
+     * @return bytes copied, 0 at the end
+     */
+    size_t read(size_t offset, void *buf, size_t len) const;
+
+    /**
+     * @brief Set the listener of the input events
+     */
+    void setEventListener(input_trace_listener_t listener, void *arg = nullptr) {
+        _listener = listener;
+        _listenerArg = arg;
+    }
+
+    /**
+     * @brief Report an event to the listener
+     */
+    inline void event(uint8_t source, uint8_t event) {
+        if (_listener != nullptr) _listener(source, event, micros(), _listenerArg);
+    }
+
+private:
+    uint32_t _records[INPUT_TRACE_RECORDS] = {};
+    size_t _count = 0;
+    uint32_t _dropped = 0;
+    uint32_t _lastUs = 0;
+    volatile bool _recording = false;
+    input_trace_listener_t _listener = nullptr;
+    void *_listenerArg = nullptr;
+    CriticalSection _lock;
+};
+
+/**
+ * @brief Iterate the edges of a serialized trace
+ */
+class InputTraceReader {
+public:
+    InputTraceReader(const void *data, size_t length);
+
+    /**
+     * @brief true if the header is valid
+     */
+    bool isValid() const {
+        return _valid;
+    }
+
+    const input_trace_header_t &header() const {
+        return _header;
+    }
+
+    /**
+     * @brief Next edge
+     * @return false at the end of the trace
+     */
+    bool next(input_trace_edge_t &edge);
+
+    /**
+     * @brief Go back to the first edge
+     */
+    void rewind() {
+        _index = 0;
+        _timeUs = 0;
+    }
+
+private:
+    const uint8_t *_records = nullptr;
+    input_trace_header_t _header{};
+    size_t _index = 0;
+    uint64_t _timeUs = 0;
+    bool _valid = false;
+};
+
+extern InputTrace GI_Trace;
+
+
+#endif //INPUTTRACE_H
@@ -0,0 +1,167 @@
+#include "LastStateCache.h"
+#include "GPIO_helper.h"
+
+#define LS_WORD(i) ((i) >> 5)
+#define LS_BIT(i) (1UL << ((i) & 31))
+
+
+int16_t LastStateCache::add(const String *key) {
+    if (key == nullptr) return -1;
+    int16_t index = -1;
+    _lock.enter();
+    for (uint16_t i = 0; i < _count; i++) {
+        if (_keys[i] == nullptr) {
+            if (index < 0) index = (int16_t) i; // slot of a removed device
+            continue;
+        }
+        if (_keys[i] == key || *_keys[i] == *key) {
+            _lock.exit();
+            return (int16_t) i;
+        }
+    }
+    if (index >= 0) {
+        // the store state known for the previous device does not apply to this one
+        uint32_t w = LS_WORD(index);
+        uint32_t bit = LS_BIT(index);
+        _state[w] &= ~bit;
+        _known[w] &= ~bit;
+        _stored[w] &= ~bit;
+        _keys[index] = key;
+    } else if (_count < LAST_STATE_MAX_DEVICES) {
+        index = (int16_t) _count;
+        _keys[_count++] = key;
+    }
+    _lock.exit();
+    return index;
+}
+
+void LastStateCache::remove(int16_t index) {
+    if (index < 0 || index >= (int16_t) _count) return;
+    uint32_t w = LS_WORD(index);
+    uint32_t bit = LS_BIT(index);
+    _lock.enter();
+    const String *key = _keys[index];
+    bool dirty = _dirty[w] & bit;
+    bool state = _state[w] & bit;
+    _keys[index] = nullptr;
+    if (dirty) {
+        _dirty[w] &= ~bit;
+        _pending--;
+        _stats.written++;
+    }
+    _lock.exit();
+    if (dirty && key != nullptr && _writer != nullptr) {
+        _writer(*key, state);
+    }
+}
+
+void LastStateCache::set(int16_t index, bool state) {
+    if (index < 0 || index >= (int16_t) _count || _keys[index] == nullptr) return;
+    uint32_t w = LS_WORD(index);
+    uint32_t bit = LS_BIT(index);
+    bool flushNow = false;
+    bool armTimer = false;
+    _lock.enter();
+    _stats.requested++;
+    if (state) {
+        _state[w] |= bit;
+    } else {
+        _state[w] &= ~bit;
+    }
+    bool unchanged = (_known[w] & bit) && ((_stored[w] & bit) != 0) == state;
+    if (_dirty[w] & bit) {
+        // the pending state is overwritten before reaching flash
+        _stats.avoided++;
+        if (unchanged) {
+            _dirty[w] &= ~bit;
+            _pending--;
+        }
+    } else if (unchanged) {
+        _stats.avoided++;
+    } else {
+        _dirty[w] |= bit;
+        armTimer = _pending++ == 0;
+    }
+    flushNow = _pending >= _flushThreshold;
+    _lock.exit();
+    if (flushNow) {
+        GPIO_Timer.cancel(&_flushTimer);
+        _scheduleFlush();
+    } else if (armTimer) {
+        GPIO_Timer.arm(&_flushTimer, _flushInterval);
+    }
+}
+
+void LastStateCache::setStored(int16_t index, bool state) {
+    if (index < 0 || index >= (int16_t) _count) return;
+    uint32_t w = LS_WORD(index);
+    uint32_t bit = LS_BIT(index);
+    _lock.enter();
+    _known[w] |= bit;
+    if (state) {
+        _stored[w] |= bit;
+    } else {
+        _stored[w] &= ~bit;
+    }
+    _lock.exit();
+}
+
+uint16_t LastStateCache::flush() {
+    uint16_t written = 0;
+    GPIO_Timer.cancel(&_flushTimer);
+    for (uint16_t w = 0; w < LAST_STATE_WORDS; w++) {
+        // take the dirty bits of one word, changes made while writing start a new window
+        _lock.enter();
+        uint32_t dirty = _dirty[w];
+        uint32_t state = _state[w];
+        _dirty[w] = 0;
+        _pending -= __builtin_popcount(dirty);
+        _stored[w] = (_stored[w] & ~dirty) | (state & dirty);
+        _known[w] |= dirty;
+        _lock.exit();
+        while (dirty) {
+            uint8_t b = __builtin_ctz(dirty);
+            dirty &= dirty - 1;
+            uint16_t index = w * 32 + b;
+            const String *key = _keys[index];
+            if (_writer != nullptr && key != nullptr) {
+                _writer(*key, (state >> b) & 1);
+            }
+            written++;
+        }
+    }
+    _lock.enter();
+    _stats.written += written;
+    _stats.flushes++;
+    _flushScheduled = false;
+    bool rearm = _pending > 0;
+    _lock.exit();
+    if (rearm) {
+        // changed while flushing
+        GPIO_Timer.arm(&_flushTimer, _flushInterval);
+    }
+    return written;
+}
+
+void LastStateCache::_scheduleFlush() {
+    _lock.enter();
+    bool schedule = !_flushScheduled;
+    _flushScheduled = true;
+    _lock.exit();
+    if (schedule && !GPIO_Scheduler.addSchedule(_flushTask, this, SCHEDULE_LANE_BACKGROUND)) {
+        // scheduler is full, retry on the next window
+        _lock.enter();
+        _flushScheduled = false;
+        _lock.exit();
+        GPIO_Timer.arm(&_flushTimer, _flushInterval);
+    }
+}
+
+void LastStateCache::_onFlushTimer(void *arg) {
+    // timer context, the store is written from the scheduler
+    static_cast<LastStateCache *>(arg)->_scheduleFlush();
+}
+
+void LastStateCache::_flushTask(void *arg) {
+    static_cast<LastStateCache *>(arg)->flush();
+}
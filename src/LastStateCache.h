@@ -0,0 +1,143 @@
+#ifndef LASTSTATECACHE_H
+#define LASTSTATECACHE_H
+
+#include <Arduino.h>
+#include "CriticalSection.h"
+#include "TimerWheel.h"
+
+/* Number of devices tracked by the cache, devices beyond that are written through */
+#ifndef LAST_STATE_MAX_DEVICES
+#define LAST_STATE_MAX_DEVICES 64
+#endif
+
+/* Flush pending states this many milliseconds after the first change */
+#ifndef LAST_STATE_FLUSH_INTERVAL
+#define LAST_STATE_FLUSH_INTERVAL 2000
+#endif
+
+/* Flush as soon as this many devices are pending */
+#ifndef LAST_STATE_FLUSH_THRESHOLD
+#define LAST_STATE_FLUSH_THRESHOLD 16
+#endif
+
+#define LAST_STATE_WORDS ((LAST_STATE_MAX_DEVICES + 31) / 32)
+
+struct last_state_stats_t {
+    uint32_t requested = 0; // state changes received
+    uint32_t written = 0;   // states written to flash
+    uint32_t avoided = 0;   // state changes that never reached flash (overwritten or unchanged)
+    uint32_t flushes = 0;
+};
+
+/**
+ * @brief Write-behind cache for the last state of outputs.
+ *
+ * set() only updates a RAM bitmap and marks the device dirty. Dirty devices are written to
+ * the store by flush(), which runs on GPIO_Scheduler after the flush interval or once the
+ * threshold of pending devices is reached. Only the final state of each device per window reaches flash.
+ *
+ * Call flush() before a reboot or an OTA update so pending states are not lost.
+ */
+class LastStateCache {
+public:
+    typedef bool (*write_fn_t)(const String &key, bool state);
+
+    /**
+     * @param writer function writing one state to the store
+     */
+    constexpr explicit LastStateCache(write_fn_t writer) : _writer(writer) {}
+
+    /**
+     * @brief Register a device
+     * @param key persistent key of the device. Must outlive the cache (the device owns it)
+     * @return index of the device, -1 if the cache is full. The slots of removed devices are reused
+     */
+    int16_t add(const String *key);
+
+    /**
+     * @brief Unregister a device, its pending state is written first
+     * @param index from add()
+     */
+    void remove(int16_t index);
+
+    /**
+     * @brief Record a new state for a device
+     * @param index from add()
+     * @param state
+     */
+    void set(int16_t index, bool state);
+
+    /**
+     * @brief Tell the cache which state the store already holds for a device (e.g. read at boot),
+     * so writing the same state again is skipped
+     * @param index from add()
+     * @param state
+     */
+    void setStored(int16_t index, bool state);
+
+    /**
+     * @brief Write every pending state to the store now
+     * @return number of states written
+     */
+    uint16_t flush();
+
+    /**
+     * @brief Replace the function writing one state to the store
+     */
+    void setWriter(write_fn_t writer) {
+        _writer = writer;
+    }
+
+    /**
+     * @brief Set the flush interval in milliseconds
+     */
+    void setFlushInterval(uint32_t ms) {
+        _flushInterval = ms;
+    }
+
+    /**
+     * @brief Set the number of pending devices that triggers an immediate flush
+     */
+    void setFlushThreshold(uint16_t count) {
+        _flushThreshold = count;
+    }
+
+    /**
+     * @brief Number of devices waiting to be written
+     */
+    uint16_t pending() const {
+        return _pending;
+    }
+
+    /**
+     * @brief Write counters
+     */
+    last_state_stats_t getStats() const {
+        return _stats;
+    }
+
+private:
+    const String *_keys[LAST_STATE_MAX_DEVICES] = {};
+    uint32_t _state[LAST_STATE_WORDS] = {};
+    uint32_t _dirty[LAST_STATE_WORDS] = {};
+    uint32_t _stored[LAST_STATE_WORDS] = {};   // state held by the store
+    uint32_t _known[LAST_STATE_WORDS] = {};    // _stored is valid
+    uint16_t _count = 0;
+    uint16_t _pending = 0;
+    uint32_t _flushInterval = LAST_STATE_FLUSH_INTERVAL;
+    uint16_t _flushThreshold = LAST_STATE_FLUSH_THRESHOLD;
+    bool _flushScheduled = false;
+    write_fn_t _writer = nullptr;
+    last_state_stats_t _stats;
+    timer_node_t _flushTimer{_onFlushTimer, this};
+    CriticalSection _lock;
+
+    void _scheduleFlush();
+
+    static void _onFlushTimer(void *arg);
+
+    static void _flushTask(void *arg);
+};
+
+
+#endif //LASTSTATECACHE_H
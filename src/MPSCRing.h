@@ -0,0 +1,185 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#if defined(ESP8266)
+#include <Arduino.h>
+#endif
+
+/**
+ * @brief Round up to the next power of two (compile time)
+ */
+constexpr size_t mpsc_ring_capacity(size_t n) {
+    size_t c = 1;
+    while (c < n) c <<= 1;
+    return c;
+}
+
+/**
+ * @brief Bounded multi-producer / single-consumer lock-free ring buffer.
+ *
+ * Items are constructed in place inside the ring, so push() and pop() never allocate
+ * by themselves. Every slot carries a sequence number: producers reserve a position with
+ * a single compare-and-swap and publish the slot by bumping its sequence, the consumer
+ * only touches slots that have been published. push() is O(1) and may be called from
+ * tasks, esp_timer callbacks and ISRs at the same time. pop() must only be called from one
+ * context at a time.
+ *
+ * Sequence numbers are stored relative to the slot index, so an all-zero ring is a valid empty
+ * ring: a global ring is constant-initialized and can be used from other global constructors.
+ *
+ * @tparam T item type. Constructing/moving T must not allocate if push() is used from an ISR
+ * @tparam Capacity number of slots, rounded up to a power of two
+ */
+template<typename T, size_t Capacity>
+class MPSCRing {
+public:
+    static constexpr size_t capacity = mpsc_ring_capacity(Capacity);
+
+    // with one slot "published" (lap + 1) and "free for the next lap" (lap + capacity) are equal
+    static_assert(capacity >= 2, "MPSCRing needs at least 2 slots");
+
+    constexpr MPSCRing() = default;
+
+    ~MPSCRing() {
+        clear();
+    }
+
+    MPSCRing(const MPSCRing &) = delete;
+
+    MPSCRing &operator=(const MPSCRing &) = delete;
+
+    /**
+     * @brief Construct an item in place at the tail of the ring
+     * @return false if the ring is full
+     */
+    template<typename... Args>
+    bool emplace(Args &&... args) {
+        Cell *cell;
+        if (!_reserve(cell)) return false;
+        new(cell->ptr()) T(std::forward<Args>(args)...);
+        cell->seq.store(_lap(cell->pos) + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Push an item to the tail of the ring
+     * @return false if the ring is full
+     */
+    bool push(T &&item) {
+        return emplace(std::move(item));
+    }
+
+    bool push(const T &item) {
+        return emplace(item);
+    }
+
+    /**
+     * @brief Move the item at the head of the ring into `out`. Single consumer only.
+     * @return false if the ring is empty (or the head slot is still being written)
+     */
+    bool pop(T &out) {
+        size_t pos = _dequeuePos;
+        Cell &cell = _cells[pos & (capacity - 1)];
+        if (cell.seq.load(std::memory_order_acquire) != _lap(pos) + 1) return false;
+        _dequeuePos = pos + 1;
+        T *item = cell.ptr();
+        out = std::move(*item);
+        item->~T();
+        cell.seq.store(_lap(pos) + capacity, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Drop every published item. Single consumer only.
+     */
+    void clear() {
+        size_t pos = _dequeuePos;
+        for (;;) {
+            Cell &cell = _cells[pos & (capacity - 1)];
+            if (cell.seq.load(std::memory_order_acquire) != _lap(pos) + 1) break;
+            cell.ptr()->~T();
+            cell.seq.store(_lap(pos) + capacity, std::memory_order_release);
+            ++pos;
+        }
+        _dequeuePos = pos;
+    }
+
+    /**
+     * @brief Approximate number of items in the ring
+     */
+    size_t size() const {
+        size_t head = _dequeuePos;
+        size_t tail = _enqueuePos.load(std::memory_order_relaxed);
+        return tail - head;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{0}; // sequence minus slot index
+        size_t pos = 0;
+        alignas(T) unsigned char storage[sizeof(T)]{};
+
+        T *ptr() {
+            return reinterpret_cast<T *>(storage);
+        }
+    };
+
+    Cell _cells[capacity]{};
+    std::atomic<size_t> _enqueuePos{0};
+    size_t _dequeuePos = 0;
+
+    static constexpr size_t _lap(size_t pos) {
+        return pos & ~(capacity - 1);
+    }
+
+    /**
+     * @brief Claim the next free slot for a producer
+     */
+    bool _reserve(Cell *&out) {
+#if defined(ESP8266)
+        // The lx106 core has no compare-and-swap instruction. It is single core, so masking
+        // interrupts around the claim gives the same guarantee and is safe from an ISR.
+        uint32_t ps = xt_rsil(15);
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell = &_cells[pos & (capacity - 1)];
+        bool ok = cell->seq.load(std::memory_order_relaxed) == _lap(pos);
+        if (ok) _enqueuePos.store(pos + 1, std::memory_order_relaxed);
+        xt_wsr_ps(ps);
+        if (!ok) return false;
+        cell->pos = pos;
+        out = cell;
+        return true;
+#else
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell *cell = &_cells[pos & (capacity - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) _lap(pos);
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell->pos = pos;
+                    out = cell;
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+#endif
+    }
+};
+
+
+#endif //MPSCRING_H
@@ -0,0 +1,291 @@
+#include "MatrixKeypad.h"
+
+
+MatrixKeypad::MatrixKeypad(const uint8_t *rowPins, uint8_t rows, const uint8_t *colPins, uint8_t cols,
+                           uint32_t periodMs)
+    : _rows(rows < KEYPAD_MAX_ROWS ? rows : KEYPAD_MAX_ROWS),
+      _cols(cols < KEYPAD_MAX_COLS ? cols : KEYPAD_MAX_COLS),
+      _periodMs(periodMs > 0 ? periodMs : 1) {
+    if (rows > KEYPAD_MAX_ROWS || cols > KEYPAD_MAX_COLS) {
+        Serial.printf("[Err][MatrixKeypad] At most %dx%d keys\n", KEYPAD_MAX_ROWS, KEYPAD_MAX_COLS);
+    }
+    memcpy(_rowPins, rowPins, _rows);
+    memcpy(_colPins, colPins, _cols);
+    for (uint8_t c = 0; c < _cols; c++) {
+        if (_colPins[c] >= INPUT_SCAN_PINS) {
+            Serial.printf("[Err][MatrixKeypad] Invalid column pin %d\n", _colPins[c]);
+            continue;
+        }
+        _colMask[_colPins[c] / 32] |= 1UL << (_colPins[c] % 32);
+        _colWords |= 1UL << (_colPins[c] / 32);
+    }
+    _setupKeys();
+}
+
+#if defined(USE_PCF)
+
+MatrixKeypad::MatrixKeypad(PCF_TYPE &pcf, const uint8_t *rowPins, uint8_t rows, const uint8_t *colPins, uint8_t cols,
+                           uint32_t periodMs)
+    : _rows(rows < KEYPAD_MAX_ROWS ? rows : KEYPAD_MAX_ROWS),
+      _cols(cols < KEYPAD_MAX_COLS ? cols : KEYPAD_MAX_COLS),
+      _periodMs(periodMs > 0 ? periodMs : 1),
+      _expander(true),
+      _port(PCFPort::get(&pcf)) {
+    if (rows > KEYPAD_MAX_ROWS || cols > KEYPAD_MAX_COLS) {
+        Serial.printf("[Err][MatrixKeypad] At most %dx%d keys\n", KEYPAD_MAX_ROWS, KEYPAD_MAX_COLS);
+    }
+    memcpy(_rowPins, rowPins, _rows);
+    memcpy(_colPins, colPins, _cols);
+    _setupKeys();
+}
+
+#endif
+
+MatrixKeypad::~MatrixKeypad() {
+    end();
+    delete[] _keys;
+}
+
+void MatrixKeypad::_setupKeys() {
+    uint8_t count = _rows * _cols;
+    _keys = new GenericButton[count > 0 ? count : 1];
+    for (uint8_t i = 0; i < count; i++) {
+        GenericInput &key = _keys[i];
+        key._pin = UINT8_MAX; // no pin of its own, never attached
+        key._activeState = LOW;
+        key._lastState = HIGH;
+        key._debounceTime = 0;
+        key._scanned = true;
+        key._scanLevel = HIGH;
+        _keyMask[i / 32] |= 1UL << (i % 32);
+    }
+    for (uint8_t w = 0; w < KEYPAD_WORDS; w++) {
+        _debounce[w].reset(UINT32_MAX, UINT32_MAX); // released
+    }
+}
+
+void MatrixKeypad::begin() {
+    if (_running) return;
+#if defined(USE_PCF)
+    if (_expander && _port == nullptr) return; // no shadow register left for the expander
+    if (_port != nullptr) {
+        for (uint8_t r = 0; r < _rows; r++) {
+            _port->pinMode(_rowPins[r], OUTPUT);
+            _port->digitalWrite(_rowPins[r], HIGH);
+        }
+        for (uint8_t c = 0; c < _cols; c++) {
+            _port->pinMode(_colPins[c], INPUT);
+        }
+    } else
+#endif
+    {
+        for (uint8_t r = 0; r < _rows; r++) {
+            digitalWrite(_rowPins[r], HIGH);
+            pinMode(_rowPins[r], OUTPUT_OPEN_DRAIN);
+        }
+        for (uint8_t c = 0; c < _cols; c++) {
+            pinMode(_colPins[c], INPUT_PULLUP);
+        }
+    }
+    _rowsDriven = 0;
+    _scanCount = 0;
+    _idle = false;
+    _running = true;
+    GPIO_Timer.arm(&_timer, 0);
+}
+
+void MatrixKeypad::end() {
+    if (!_running) return;
+    _running = false;
+    GPIO_Timer.cancel(&_timer);
+    _detachWake();
+    _idle = false;
+#if defined(USE_PCF)
+    // the rows of an expander are released by the next commit of the scheduler
+    if (_port != nullptr) {
+        for (uint8_t r = 0; r < _rows; r++) {
+            _port->digitalWrite(_rowPins[r], HIGH);
+        }
+        _rowsDriven = 0;
+        return;
+    }
+#endif
+    _driveRows(0);
+}
+
+void MatrixKeypad::_driveRows(uint32_t rows) {
+    uint32_t changed = rows ^ _rowsDriven;
+    if (changed == 0) return;
+    _rowsDriven = rows;
+#if defined(USE_PCF)
+    if (_port != nullptr) {
+        for (; changed; changed &= changed - 1) {
+            uint8_t r = __builtin_ctz(changed);
+            _port->digitalWrite(_rowPins[r], !((rows >> r) & 1));
+        }
+        _port->commit();
+        return;
+    }
+#endif
+    for (; changed; changed &= changed - 1) {
+        uint8_t r = __builtin_ctz(changed);
+        digitalWrite(_rowPins[r], !((rows >> r) & 1));
+    }
+    delayMicroseconds(KEYPAD_SETTLE_US);
+}
+
+bool MatrixKeypad::_readColumns(uint32_t &levels) {
+    levels = 0;
+#if defined(USE_PCF)
+    if (_port != nullptr) {
+        uint16_t value;
+        if (!_port->read(value)) return false;
+        for (uint8_t c = 0; c < _cols; c++) {
+            if ((value >> _colPins[c]) & 1) levels |= 1UL << c;
+        }
+        return true;
+    }
+#endif
+    uint32_t words[INPUT_SCAN_WORDS] = {};
+    for (uint8_t w = 0; w < INPUT_SCAN_WORDS; w++) {
+        if ((_colWords >> w) & 1) words[w] = InputScanner::readPins(w, _colMask[w]);
+    }
+    for (uint8_t c = 0; c < _cols; c++) {
+        uint8_t pin = _colPins[c];
+        if (pin < INPUT_SCAN_PINS && ((words[pin / 32] >> (pin % 32)) & 1)) levels |= 1UL << c;
+    }
+    return true;
+}
+
+void MatrixKeypad::scan() {
+    uint32_t sample[KEYPAD_WORDS];
+    for (auto &word: sample) word = UINT32_MAX;
+    for (uint8_t r = 0; r < _rows; r++) {
+        _driveRows(1UL << r);
+        uint32_t levels;
+        // a failed read keeps the keys of the row released
+        if (!_readColumns(levels)) continue;
+        for (uint32_t pressed = ~levels & ((1UL << _cols) - 1); pressed; pressed &= pressed - 1) {
+            uint8_t i = r * _cols + __builtin_ctz(pressed);
+            sample[i / 32] &= ~(1UL << (i % 32));
+        }
+    }
+    _driveRows(0);
+    _scanCount++;
+
+    uint32_t now = micros();
+    for (uint8_t w = 0; w < KEYPAD_WORDS; w++) {
+        if (_keyMask[w] == 0) continue;
+        /* dispatch the changed keys only */
+        for (uint32_t toggle = _debounce[w].update(sample[w]) & _keyMask[w]; toggle; toggle &= toggle - 1) {
+            uint8_t bit = __builtin_ctz(toggle);
+            GenericInput &key = _keys[w * 32 + bit];
+            bool level = (_debounce[w].state >> bit) & 1;
+            key._scanLevel = level;
+            // the change started with the first of the equal samples
+            key._pushEdge(level, now - (INPUT_SCAN_SAMPLES - 1) * _periodMs * 1000);
+            key._processHandler();
+        }
+    }
+}
+
+bool MatrixKeypad::_keysIdle() const {
+    for (uint8_t w = 0; w < KEYPAD_WORDS; w++) {
+        if ((~_debounce[w].state & _keyMask[w]) != 0 || _debounce[w].busy()) return false;
+    }
+    return true;
+}
+
+bool MatrixKeypad::_canWake() const {
+#if defined(USE_PCF)
+    if (_port != nullptr) return _intPin != UINT8_MAX;
+#endif
+    for (uint8_t c = 0; c < _cols; c++) {
+        if (digitalPinToInterrupt(_colPins[c]) < 0) return false;
+    }
+    return true;
+}
+
+void MatrixKeypad::_attachWake() {
+    if (_wakeAttached) return;
+    _wakeAttached = true;
+#if defined(USE_PCF)
+    if (_port != nullptr) {
+        pinMode(_intPin, INPUT_PULLUP);
+        ::attachInterruptArg(_intPin, _wakeHandler, this, FALLING);
+        return;
+    }
+#endif
+    for (uint8_t c = 0; c < _cols; c++) {
+        ::attachInterruptArg(_colPins[c], _wakeHandler, this, FALLING);
+    }
+}
+
+void MatrixKeypad::_detachWake() {
+    if (!_wakeAttached) return;
+    _wakeAttached = false;
+#if defined(USE_PCF)
+    if (_port != nullptr) {
+        ::detachInterrupt(_intPin);
+        return;
+    }
+#endif
+    for (uint8_t c = 0; c < _cols; c++) {
+        ::detachInterrupt(_colPins[c]);
+    }
+}
+
+bool MatrixKeypad::_enterIdle() {
+    _driveRows((1UL << _rows) - 1);
+    _idle = true;
+    bool wake = _canWake();
+    if (wake) _attachWake();
+    // read after attaching: a key pressed meanwhile is either seen here or interrupts
+    // (the read also re-arms the INT line of an expander)
+    uint32_t levels;
+    if (!_readColumns(levels) || levels != (1UL << _cols) - 1) {
+        _idle = false;
+        _detachWake();
+        return false;
+    }
+    return wake;
+}
+
+void MatrixKeypad::_poll() {
+    if (!_running) return;
+    if (_idle) {
+        // no wake interrupt: one read with every row driven instead of a scan
+        uint32_t levels;
+        if (_readColumns(levels) && levels == (1UL << _cols) - 1) {
+            GPIO_Timer.arm(&_timer, _periodMs);
+            return;
+        }
+        _idle = false;
+    }
+    _detachWake();
+    scan();
+    if (_keysIdle() && _enterIdle()) return;
+    GPIO_Timer.arm(&_timer, _periodMs);
+}
+
+void MatrixKeypad::_pollTask(void *arg) {
+    static_cast<MatrixKeypad *>(arg)->_poll();
+}
+
+void MatrixKeypad::_timerTask(void *arg) {
+#if defined(USE_PCF)
+    // I2C is not used from the timer
+    if (static_cast<MatrixKeypad *>(arg)->_port != nullptr) {
+        GPIO_Scheduler.addSchedule(_pollTask, arg);
+        return;
+    }
+#endif
+    _pollTask(arg);
+}
+
+IRAM_ATTR void MatrixKeypad::_wakeHandler(void *arg) {
+    auto *keypad = static_cast<MatrixKeypad *>(arg);
+    if (!keypad->_idle) return;
+    keypad->_idle = false;
+    GPIO_Timer.arm(&keypad->_timer, 0);
+}
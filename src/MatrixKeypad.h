@@ -0,0 +1,229 @@
+#ifndef MATRIXKEYPAD_H
+#define MATRIXKEYPAD_H
+
+#include <Arduino.h>
+#include "GenericButton.h"
+#include "InputScanner.h"
+
+#ifndef KEYPAD_MAX_ROWS
+#define KEYPAD_MAX_ROWS 8
+#endif
+
+#ifndef KEYPAD_MAX_COLS
+#define KEYPAD_MAX_COLS 8
+#endif
+
+#define KEYPAD_MAX_KEYS (KEYPAD_MAX_ROWS * KEYPAD_MAX_COLS)
+#define KEYPAD_WORDS ((KEYPAD_MAX_KEYS + 31) / 32)
+
+/* Default scan period in milliseconds, the debounce time is INPUT_SCAN_SAMPLES periods */
+#ifndef KEYPAD_SCAN_PERIOD_MS
+#define KEYPAD_SCAN_PERIOD_MS 5
+#endif
+
+/* Settling time of the column lines after a row is driven (on-chip pins) */
+#ifndef KEYPAD_SETTLE_US
+#define KEYPAD_SETTLE_US 5
+#endif
+
+/**
+ * @brief Matrix keypad whose keys are GenericButton objects.
+ *
+ * A row is driven LOW at a time and the columns (pulled up) are read in one port read: one
+ * register read for on-chip pins, one I2C read for an expander. A pressed key pulls its column
+ * LOW. The samples are debounced with the vertical counters of InputScanner, and only the keys
+ * that changed are fed to their GenericButton, so clicks, double clicks and holds work as on a
+ * single button. The debounce time of the keys is INPUT_SCAN_SAMPLES scan periods.
+ *
+ * While every key is released, all rows are driven LOW and the matrix is not scanned:
+ * - on-chip columns wake the keypad with a FALLING interrupt;
+ * - expander columns wake it with the INT line of the expander (setInterruptPin()), or
+ *   without it with one port read per period instead of a scan of every row.
+ *
+ * Rows are open drain, so two keys pressed in one column never short two rows. Without a diode
+ * per key, three keys pressed at the corners of a rectangle also show the fourth one.
+ * Input only pins (ESP32 GPIO 34..39) need external pull-ups as columns.
+ *
+ * Expander scans touch I2C, so they run in GPIO_Scheduler; on-chip scans run in the timer.
+ *
+ * Example:
+ * @code
+ * const uint8_t rows[] = {13, 12, 14, 27};
+ * const uint8_t cols[] = {26, 25, 33, 32};
+ * MatrixKeypad keypad(rows, 4, cols, 4);
+ *
+ * void setup() {
+ *     keypad.key(0, 0).onClick([]() { Serial.println("1"); });
+ *     keypad.key(3, 3).onPressHold(2000, []() { Serial.println("D held"); });
+ *     keypad.begin();
+ * }
+ * @endcode
+ */
+class MatrixKeypad {
+public:
+    /**
+     * @brief Keypad on on-chip pins
+     * @param rowPins driven pins
+     * @param rows number of rows, up to KEYPAD_MAX_ROWS
+     * @param colPins read pins
+     * @param cols number of columns, up to KEYPAD_MAX_COLS
+     * @param periodMs scan period
+     */
+    MatrixKeypad(const uint8_t *rowPins, uint8_t rows, const uint8_t *colPins, uint8_t cols,
+                 uint32_t periodMs = KEYPAD_SCAN_PERIOD_MS);
+
+#if defined(USE_PCF)
+
+    /**
+     * @brief Keypad on the pins of an expander. The expander is used by the keypad only
+     * @param pcf PCF8574|PCF8575 object
+     * @param rowPins driven expander pins
+     * @param rows number of rows, up to KEYPAD_MAX_ROWS
+     * @param colPins read expander pins
+     * @param cols number of columns, up to KEYPAD_MAX_COLS
+     * @param periodMs scan period
+     */
+    MatrixKeypad(PCF_TYPE &pcf, const uint8_t *rowPins, uint8_t rows, const uint8_t *colPins, uint8_t cols,
+                 uint32_t periodMs = KEYPAD_SCAN_PERIOD_MS);
+
+#endif
+
+    MatrixKeypad(const MatrixKeypad &) = delete;
+
+    MatrixKeypad &operator=(const MatrixKeypad &) = delete;
+
+    ~MatrixKeypad();
+
+    /**
+     * @brief Button of a key, register its callbacks like on any GenericButton
+     */
+    GenericButton &key(uint8_t row, uint8_t col) {
+        return _keys[row * _cols + col];
+    }
+
+    uint8_t getRows() const {
+        return _rows;
+    }
+
+    uint8_t getCols() const {
+        return _cols;
+    }
+
+    /**
+     * @brief Set up the pins and start scanning
+     */
+    void begin();
+
+    /**
+     * @brief Stop scanning, the rows are released
+     */
+    void end();
+
+    /**
+     * @brief Set the scan period
+     */
+    void setPeriod(uint32_t periodMs) {
+        _periodMs = periodMs > 0 ? periodMs : 1;
+    }
+
+    uint32_t getPeriod() const {
+        return _periodMs;
+    }
+
+#if defined(USE_PCF)
+
+    /**
+     * @brief Board pin wired to the INT line of the expander, wakes the keypad when idle
+     */
+    void setInterruptPin(uint8_t pin) {
+        _intPin = pin;
+    }
+
+#endif
+
+    /**
+     * @brief true while every key is released and the matrix is not scanned
+     */
+    bool isIdle() const {
+        return _idle;
+    }
+
+    /**
+     * @brief Full scans of the matrix since begin()
+     */
+    uint32_t getScanCount() const {
+        return _scanCount;
+    }
+
+    /**
+     * @brief Scan every row once and dispatch the debounced changes
+     */
+    void scan();
+
+private:
+    GenericButton *_keys;
+    uint8_t _rowPins[KEYPAD_MAX_ROWS] = {};
+    uint8_t _colPins[KEYPAD_MAX_COLS] = {};
+    uint8_t _rows;
+    uint8_t _cols;
+    uint32_t _periodMs;
+    uint32_t _rowsDriven = 0; // rows driven LOW
+    uint32_t _colWords = 0;   // register words holding the on-chip columns
+    uint32_t _colMask[INPUT_SCAN_WORDS] = {};
+    uint32_t _keyMask[KEYPAD_WORDS] = {};
+    vertical_debounce_t _debounce[KEYPAD_WORDS];
+    uint32_t _scanCount = 0;
+    bool _running = false;
+    volatile bool _idle = false;
+    bool _wakeAttached = false;
+    timer_node_t _timer{_timerTask, this};
+#if defined(USE_PCF)
+    bool _expander = false;
+    PCFPort *_port = nullptr;
+    uint8_t _intPin = UINT8_MAX;
+#endif
+
+    void _setupKeys();
+
+    /**
+     * @brief Drive the rows of a mask LOW and release the others
+     */
+    void _driveRows(uint32_t rows);
+
+    /**
+     * @brief Level of every column, bit c is column c
+     * @return false if the port could not be read
+     */
+    bool _readColumns(uint32_t &levels);
+
+    /**
+     * @brief true if every key is released and no change is being debounced
+     */
+    bool _keysIdle() const;
+
+    /**
+     * @brief Drive every row and stop scanning until a column goes LOW
+     * @return true if the timer is stopped (woken by interrupt)
+     */
+    bool _enterIdle();
+
+    bool _canWake() const;
+
+    void _attachWake();
+
+    void _detachWake();
+
+    /**
+     * @brief One period: check the idle columns or scan the matrix
+     */
+    void _poll();
+
+    static void _timerTask(void *arg);
+
+    static void _pollTask(void *arg);
+
+    IRAM_ATTR static void _wakeHandler(void *arg);
+};
+
+
+#endif //MATRIXKEYPAD_H
@@ -0,0 +1,143 @@
+#include "OutputGroup.h"
+
+#if defined(ESP32)
+#include <soc/gpio_reg.h>
+#include <soc/soc_caps.h>
+#endif
+
+
+int8_t OutputGroup::add(GenericOutputBase &output) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_outputs[i] == &output) return (int8_t) i;
+    }
+    if (_count >= OUTPUT_GROUP_MAX) {
+        Serial.println("[Err][OutputGroup] Group is full");
+        return -1;
+    }
+    _outputs[_count] = &output;
+    return (int8_t) _count++;
+}
+
+void OutputGroup::set(uint32_t states, uint32_t mask, bool force) {
+    if (_count < 32) mask &= (1UL << _count) - 1;
+    uint32_t changed = 0;
+    uint32_t setMask = 0, clearMask = 0;
+#if defined(ESP32)
+    uint32_t setMask1 = 0, clearMask1 = 0; // GPIO32..
+#elif defined(ESP8266)
+    int8_t gpio16 = -1;
+#endif
+#if defined(USE_PCF)
+    bool pcf = false;
+#endif
+
+    /* collect the pin levels */
+    for (uint32_t pending = mask; pending; pending &= pending - 1) {
+        uint8_t i = __builtin_ctz(pending);
+        GenericOutputBase *output = _outputs[i];
+        bool state = (states >> i) & 1;
+        if (output->_state == state && !force) continue;
+        changed |= 1UL << i;
+        output->_state = state;
+        if (output->_pin == UINT8_MAX) continue;
+        bool level = state ? output->_activeState : !output->_activeState;
+#if defined(USE_PCF)
+        if (output->_pcf != nullptr) {
+            if (!pcf) {
+                PCFPort::beginTransaction();
+                pcf = true;
+            }
+            output->_writePin(); // shadow only until endTransaction()
+            continue;
+        }
+#endif
+#if defined(ESP32)
+        if (output->_pin < 32) {
+            (level ? setMask : clearMask) |= 1UL << output->_pin;
+        } else {
+            (level ? setMask1 : clearMask1) |= 1UL << (output->_pin - 32);
+        }
+#elif defined(ESP8266)
+        if (output->_pin == 16) {
+            gpio16 = level;
+        } else {
+            (level ? setMask : clearMask) |= 1UL << output->_pin;
+        }
+#else
+        (void) level;
+        output->_writePin();
+#endif
+    }
+    if (changed == 0) return;
+
+    /* one store per register */
+#if defined(ESP32)
+    if (setMask) REG_WRITE(GPIO_OUT_W1TS_REG, setMask);
+    if (clearMask) REG_WRITE(GPIO_OUT_W1TC_REG, clearMask);
+#if SOC_GPIO_PIN_COUNT > 32
+    if (setMask1) REG_WRITE(GPIO_OUT1_W1TS_REG, setMask1);
+    if (clearMask1) REG_WRITE(GPIO_OUT1_W1TC_REG, clearMask1);
+#endif
+#elif defined(ESP8266)
+    if (setMask) GPOS = setMask;
+    if (clearMask) GPOC = clearMask;
+    if (gpio16 >= 0) GP16O = gpio16;
+#else
+    (void) setMask;
+    (void) clearMask;
+#endif
+#if defined(USE_PCF)
+    if (pcf) PCFPort::endTransaction(); // the changed pins of every expander at once
+#endif
+
+    /* last state, RTC mirror and database are batched by their own queues */
+    for (uint32_t pending = changed; pending; pending &= pending - 1) {
+        uint8_t i = __builtin_ctz(pending);
+        _outputs[i]->_storeState();
+        _outputs[i]->_groupApply(_outputs[i]->_state);
+    }
+
+    /* one dispatch for the callbacks of every changed output */
+    _lock.enter();
+    _pendingChanged |= changed;
+    _pendingStates = (_pendingStates & ~changed) | (states & changed);
+    bool schedule = !_dispatchScheduled;
+    _dispatchScheduled = true;
+    _lock.exit();
+    if (schedule && !GPIO_Scheduler.addSchedule(_dispatchTask, this, SCHEDULE_LANE_CRITICAL, _onChange.tag)) {
+        // lane full: these callbacks are dropped like any refused schedule (scheduler stats),
+        // not delivered late with the next change
+        _lock.enter();
+        _pendingChanged = 0;
+        _dispatchScheduled = false;
+        _lock.exit();
+    }
+    if (_onChange.isValid() && !_onChange.schedule) {
+        _onChange();
+    }
+}
+
+uint32_t OutputGroup::getStates() const {
+    uint32_t states = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_outputs[i]->_state) states |= 1UL << i;
+    }
+    return states;
+}
+
+void OutputGroup::_dispatchTask(void *arg) {
+    auto *group = static_cast<OutputGroup *>(arg);
+    group->_lock.enter();
+    uint32_t changed = group->_pendingChanged;
+    uint32_t states = group->_pendingStates;
+    group->_pendingChanged = 0;
+    group->_dispatchScheduled = false;
+    group->_lock.exit();
+    for (; changed; changed &= changed - 1) {
+        uint8_t i = __builtin_ctz(changed);
+        group->_outputs[i]->_groupCallbacks((states >> i) & 1);
+    }
+    if (group->_onChange.isValid() && group->_onChange.schedule) {
+        group->_onChange();
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef OUTPUTGROUP_H
+#define OUTPUTGROUP_H
+
+#include "GenericOutputBase.h"
+#include "CriticalSection.h"
+
+/* Outputs in a group, one bit of the state mask each */
+#ifndef OUTPUT_GROUP_MAX
+#define OUTPUT_GROUP_MAX 32
+#endif
+
+static_assert(OUTPUT_GROUP_MAX <= 32, "OUTPUT_GROUP_MAX is limited by the 32-bit state mask");
+
+/**
+ * @brief Switch several outputs in one operation.
+ *
+ * set() applies a bitmask of states (bit i is the i-th added output):
+ * - on-chip pins are written with one set and one clear register store, so the edges are simultaneous
+ * - PCF pins are committed together at the end, each changed pin written once
+ * - last states, RTC mirror and database updates are queued once per output and flushed in one batch
+ * - the power callbacks of every changed output and the group callback run in one scheduled dispatch
+ *
+ * The power-on delay of GenericOutput is not applied, the auto-off is.
+ *
+ * Example:
+ * @code
+ * OutputGroup relays;
+ * relays.add(relay1);
+ * relays.add(relay2);
+ * relays.set(0b10);  // relay1 off, relay2 on
+ * relays.off();      // all off
+ * @endcode
+ */
+class OutputGroup {
+public:
+    OutputGroup() = default;
+
+    /**
+     * @brief Add an output to the group
+     * @param output
+     * @return bit of the output in the state mask, -1 if the group is full
+     */
+    int8_t add(GenericOutputBase &output);
+
+    /**
+     * @brief Number of outputs
+     */
+    uint8_t size() const {
+        return _count;
+    }
+
+    /**
+     * @brief Apply new states
+     * @param states bit i is the state of the i-th output
+     * @param mask outputs to update, others are left unchanged
+     * @param force write the outputs that are already in the requested state too
+     */
+    void set(uint32_t states, uint32_t mask = UINT32_MAX, bool force = false);
+
+    /**
+     * @brief Turn on the outputs in the mask
+     */
+    void on(uint32_t mask = UINT32_MAX) {
+        set(UINT32_MAX, mask);
+    }
+
+    /**
+     * @brief Turn off the outputs in the mask
+     */
+    void off(uint32_t mask = UINT32_MAX) {
+        set(0, mask);
+    }
+
+    /**
+     * @brief Toggle the outputs in the mask
+     */
+    void toggle(uint32_t mask = UINT32_MAX) {
+        set(~getStates(), mask);
+    }
+
+    /**
+     * @brief Current states, bit i is the i-th output
+     */
+    uint32_t getStates() const;
+
+    /**
+     * @brief Set the callback called once per group change
+     * @param cb
+     * @param schedule if true, the callback will be scheduled to run in the next loop iteration
+     *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
+     */
+    void onChange(devlib_function_t cb, bool schedule = true, const char *tag = nullptr) {
+        _onChange.assign(std::move(cb), schedule, tag);
+    }
+
+private:
+    GenericOutputBase *_outputs[OUTPUT_GROUP_MAX] = {};
+    uint8_t _count = 0;
+    uint32_t _pendingChanged = 0; // outputs with callbacks waiting for the dispatch
+    uint32_t _pendingStates = 0;
+    bool _dispatchScheduled = false;
+    devlib_callback_t _onChange;
+    CriticalSection _lock;
+
+    static void _dispatchTask(void *arg);
+};
+
+
+#endif //OUTPUTGROUP_H
@@ -0,0 +1,161 @@
+#include "PCFPort.h"
+
+#if defined(USE_PCF)
+
+#include "GPIO_helper.h"
+
+PCFPort PCFPort::_ports[PCF_MAX_PORTS];
+uint8_t PCFPort::_count = 0;
+uint8_t PCFPort::_transactionDepth = 0;
+
+
+PCFPort *PCFPort::get(PCF_TYPE *pcf) {
+    if (pcf == nullptr) return nullptr;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_ports[i]._pcf == pcf) return &_ports[i];
+    }
+    if (_count >= PCF_MAX_PORTS) {
+        Serial.println("[Err][PCFPort] Too many expanders, increase PCF_MAX_PORTS");
+        return nullptr;
+    }
+    PCFPort *port = &_ports[_count++];
+    port->_pcf = pcf;
+    port->_address = pcf->getAddress();
+    return port;
+}
+
+void PCFPort::pinMode(uint8_t pin, uint8_t mode) {
+    uint16_t bit = 1U << pin;
+    _lock.enter();
+    if (mode == OUTPUT) {
+        _outputs |= bit;
+    } else {
+        // the library releases an input itself
+        _outputs &= ~bit;
+        _shadow |= bit;
+        _pending &= ~bit;
+    }
+    _modes |= bit;
+    _lock.exit();
+    _markDirty();
+}
+
+void PCFPort::digitalWrite(uint8_t pin, bool value) {
+    uint16_t bit = 1U << pin;
+    _lock.enter();
+    _stats.writes++;
+    _shadow = value ? (_shadow | bit) : (_shadow & ~bit);
+    bool changed = ((_shadow ^ _written) & bit) || !(_known & bit);
+    if (changed) {
+        _pending |= bit;
+    } else {
+        _pending &= ~bit; // set back before the commit
+    }
+    _lock.exit();
+    if (changed) _markDirty();
+}
+
+bool PCFPort::commit() {
+    _lock.enter();
+    if (!_dirty) {
+        _lock.exit();
+        return true;
+    }
+    _dirty = false;
+    uint16_t modes = _modes;
+    uint16_t outputs = _outputs;
+    _modes = 0;
+    _lock.exit();
+
+    for (; modes; modes &= modes - 1) {
+        uint8_t pin = __builtin_ctz(modes);
+        _pcf->pinMode(pin, (outputs >> pin) & 1 ? OUTPUT : INPUT);
+    }
+
+    bool ok = _writePort(_pcf, 0);
+    if (!ok) {
+        // the port state is kept: the next commit sends it again
+        _lock.enter();
+        _dirty = true;
+        _lock.exit();
+        Serial.printf("[Err][PCFPort] Failed to write 0x%02x\n", _address);
+    }
+    return ok;
+}
+
+bool PCFPort::_writePins() {
+    bool ok = true;
+    for (uint8_t pin = 0; pin < PCF_PORT_BYTES * 8; pin++) {
+        uint16_t bit = 1U << pin;
+        _lock.enter();
+        bool pending = _pending & bit;
+        bool level = _shadow & bit;
+        _lock.exit();
+        if (!pending) continue;
+        _stats.transactions++;
+        if (!_write(_pcf, pin, level, 0)) {
+            _stats.failed++;
+            ok = false;
+            continue;
+        }
+        _lock.enter();
+        _written = level ? (_written | bit) : (_written & ~bit);
+        _known |= bit;
+        // written again meanwhile: stays pending
+        if (!((_shadow ^ _written) & bit)) _pending &= ~bit;
+        _lock.exit();
+    }
+    return ok;
+}
+
+bool PCFPort::read(uint16_t &value) {
+    _stats.reads++;
+    value = _pcf->digitalReadAll();
+    return true;
+}
+
+void PCFPort::beginTransaction() {
+    _transactionDepth++;
+}
+
+void PCFPort::endTransaction() {
+    if (_transactionDepth == 0 || --_transactionDepth > 0) return;
+    for (uint8_t i = 0; i < _count; i++) {
+        _ports[i].commit();
+    }
+}
+
+pcf_port_stats_t PCFPort::getTotalStats() {
+    pcf_port_stats_t total;
+    for (uint8_t i = 0; i < _count; i++) {
+        total.writes += _ports[i]._stats.writes;
+        total.transactions += _ports[i]._stats.transactions;
+        total.reads += _ports[i]._stats.reads;
+        total.failed += _ports[i]._stats.failed;
+    }
+    return total;
+}
+
+void PCFPort::_markDirty() {
+    _lock.enter();
+    _dirty = true;
+    bool schedule = !_scheduled && _transactionDepth == 0;
+    if (schedule) _scheduled = true;
+    _lock.exit();
+    if (schedule && !GPIO_Scheduler.addSchedule(_commitTask, this)) {
+        _lock.enter();
+        _scheduled = false;
+        _lock.exit();
+    }
+}
+
+void PCFPort::_commitTask(void *arg) {
+    auto *port = static_cast<PCFPort *>(arg);
+    port->_lock.enter();
+    port->_scheduled = false;
+    port->_lock.exit();
+    if (_transactionDepth > 0) return; // endTransaction() commits
+    port->commit();
+}
+
+#endif // USE_PCF
@@ -0,0 +1,191 @@
+#ifndef PCFPORT_H
+#define PCFPORT_H
+
+#include <Arduino.h>
+
+#if __has_include(<PCF8574.h>)
+#include <PCF8574.h>
+#ifndef USE_PCF
+#define USE_PCF
+#define PCF_TYPE PCF8574
+#endif // USE_PCF
+#endif // __has_include(<PCF8574.h>)
+
+#if defined(USE_PCF)
+
+#include "CriticalSection.h"
+
+/* Expanders with a shadow register */
+#ifndef PCF_MAX_PORTS
+#define PCF_MAX_PORTS 8
+#endif
+
+/* 1 for PCF8574, 2 for PCF8575 */
+#ifndef PCF_PORT_BYTES
+#define PCF_PORT_BYTES 1
+#endif
+
+struct pcf_port_stats_t {
+    uint32_t writes = 0;       // pin writes requested
+    uint32_t transactions = 0; // writes sent to the expander
+    uint32_t reads = 0;        // port reads
+    uint32_t failed = 0;
+
+    /**
+     * @brief I2C transactions saved by batching
+     */
+    uint32_t saved() const {
+        return writes > transactions ? writes - transactions : 0;
+    }
+};
+
+/**
+ * @brief Shadow register of a PCF8574/PCF8575 output port.
+ *
+ * Pin writes only update the shadow and mark the port dirty. The pins that differ from what the
+ * expander holds are sent on the next GPIO_Scheduler run, or at the end of a transaction
+ * (beginTransaction() / endTransaction()): a pin switched several times in between is written
+ * once, a pin set back to its level is not written at all.
+ *
+ * Everything goes through the PCF library object, on its own bus, so its latch stays in sync. With
+ * a library that writes the whole port (digitalWriteAll()), a commit is a single port write: the
+ * pins of the port from the shadow, every other pin released HIGH, so pins the sketch drives
+ * itself on that expander should go through the port too. Otherwise each changed pin is one
+ * pcf.digitalWrite() and the other pins are left alone. A write the library reports as failed
+ * stays pending for the next commit.
+ *
+ * I2C is never touched from the constructors or from timer callbacks.
+ */
+class PCFPort {
+public:
+    constexpr PCFPort() = default;
+
+    /**
+     * @brief Get the port of an expander, created on first use
+     * @param pcf
+     * @return nullptr if PCF_MAX_PORTS expanders are already used
+     */
+    static PCFPort *get(PCF_TYPE *pcf);
+
+    /**
+     * @brief Set the mode of a pin, passed to the library on the next commit
+     */
+    void pinMode(uint8_t pin, uint8_t mode);
+
+    /**
+     * @brief Set the level of an output pin. Nothing is sent until the next commit
+     */
+    void digitalWrite(uint8_t pin, bool value);
+
+    /**
+     * @brief Send the pending pins now
+     * @return false if a write failed, it is retried by the next commit
+     */
+    bool commit();
+
+    /**
+     * @brief Read the whole port in one I2C transaction (digitalReadAll() of the library)
+     * @param value output, bit n is pin n
+     * @return true, the library reports no read error
+     */
+    bool read(uint16_t &value);
+
+    /**
+     * @brief Defer the commits of every port until endTransaction(). Can be nested
+     */
+    static void beginTransaction();
+
+    /**
+     * @brief Commit every dirty port now
+     */
+    static void endTransaction();
+
+    uint8_t getAddress() const {
+        return _address;
+    }
+
+    pcf_port_stats_t getStats() const {
+        return _stats;
+    }
+
+    /**
+     * @brief Stats of every port
+     */
+    static pcf_port_stats_t getTotalStats();
+
+private:
+    PCF_TYPE *_pcf = nullptr;
+    uint8_t _address = 0;
+    uint16_t _outputs = 0;   // output pins mask
+    uint16_t _shadow = 0xFFFF;
+    uint16_t _pending = 0;   // pins whose level is not on the expander yet
+    uint16_t _modes = 0;     // pins whose mode is not passed to the library yet
+    uint16_t _written = 0xFFFF;
+    uint16_t _known = 0;     // pins written through the port at least once
+    bool _dirty = false;
+    bool _scheduled = false;
+    pcf_port_stats_t _stats;
+    CriticalSection _lock;
+
+    static PCFPort _ports[PCF_MAX_PORTS];
+    static uint8_t _count;
+    static uint8_t _transactionDepth;
+
+    void _markDirty();
+
+    /**
+     * @brief Pin write through the library, its result if it has one
+     */
+    template<typename P>
+    static auto _write(P *pcf, uint8_t pin, bool value, int) -> decltype(bool(pcf->digitalWrite(pin, value))) {
+        return pcf->digitalWrite(pin, value);
+    }
+
+    template<typename P>
+    static bool _write(P *pcf, uint8_t pin, bool value, long) {
+        pcf->digitalWrite(pin, value);
+        return true;
+    }
+
+    /**
+     * @brief Whole port in one write, the library has digitalWriteAll()
+     */
+    template<typename P>
+    auto _writePort(P *pcf, int) -> decltype(bool(pcf->digitalWriteAll(uint16_t()))) {
+        _lock.enter();
+        uint16_t owned = _outputs | _known | _pending;
+        uint16_t value = (_shadow & owned) | ~owned;
+        bool pending = _pending != 0;
+        _lock.exit();
+        if (!pending) return true;
+        _stats.transactions++;
+        if (!pcf->digitalWriteAll(value)) {
+            _stats.failed++;
+            return false;
+        }
+        _lock.enter();
+        _written = value;
+        _known |= owned;
+        // written again meanwhile: stays pending
+        _pending &= _shadow ^ _written;
+        _lock.exit();
+        return true;
+    }
+
+    template<typename P>
+    bool _writePort(P *, long) {
+        return _writePins();
+    }
+
+    /**
+     * @brief One library write per pending pin
+     */
+    bool _writePins();
+
+    static void _commitTask(void *arg);
+};
+
+#endif // USE_PCF
+
+
+#endif //PCFPORT_H
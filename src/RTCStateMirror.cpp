@@ -0,0 +1,135 @@
+#include "RTCStateMirror.h"
+
+#if defined(ESP32)
+#include <esp_system.h>
+#include <esp_attr.h>
+#endif
+
+#if defined(ESP32)
+/* kept by software, watchdog and panic resets, garbage after a power-on */
+static RTC_NOINIT_ATTR rtc_state_block_t _rtcBlock;
+#else
+/* RAM copy of the block in RTC user memory (ESP8266), or the whole mirror on the host */
+static rtc_state_block_t _rtcBlock;
+#endif
+
+#if defined(ESP8266)
+static_assert(RTC_STATE_OFFSET * 4 + sizeof(rtc_state_block_t) <= 512,
+              "RTC state mirror does not fit in RTC user memory, lower RTC_STATE_MAX_DEVICES");
+#endif
+
+int8_t RTCStateMirror::add(const String &key) {
+    uint32_t hash = devlib_key_hash(key.c_str());
+    int8_t slot = -1;
+    bool collision = false, changed = false;
+    _lock.enter();
+    _load();
+    for (uint32_t i = 0; i < _rtcBlock.count; i++) {
+        if (_rtcBlock.keys[i] == hash) {
+            slot = (int8_t) i;
+            break;
+        }
+    }
+    if (slot >= 0 && (_claimed[slot >> 5] >> (slot & 31)) & 1) {
+        // two devices with the same key hash: neither is mirrored nor restored, now or after the next reset
+        _rtcBlock.ambiguous[slot >> 5] |= 1UL << (slot & 31);
+        slot = -1;
+        collision = changed = true;
+    } else if (slot < 0 && _rtcBlock.count < RTC_STATE_MAX_DEVICES) {
+        slot = (int8_t) _rtcBlock.count++;
+        _rtcBlock.keys[slot] = hash;
+        _rtcBlock.states[slot >> 5] &= ~(1UL << (slot & 31));
+        changed = true;
+    }
+    if (changed) {
+        _rtcBlock.check = ~_sum(_rtcBlock);
+#if defined(ESP8266)
+        ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, reinterpret_cast<uint32_t *>(&_rtcBlock), sizeof(_rtcBlock));
+#endif
+    }
+    if (slot >= 0) _claimed[slot >> 5] |= 1UL << (slot & 31);
+    _lock.exit();
+    if (collision) {
+        Serial.printf("[Err][RTCStateMirror] Key hash of %s is taken by another device, not mirrored\n", key.c_str());
+    } else if (slot < 0) {
+        Serial.printf("[Err][RTCStateMirror] No slot for %s\n", key.c_str());
+    }
+    return slot;
+}
+
+bool RTCStateMirror::restore(int8_t slot, bool &state) {
+    if (slot < 0 || slot >= RTC_STATE_MAX_DEVICES) return false;
+    _load();
+    uint32_t mask = 1UL << (slot & 31);
+    if (!(_restored[slot >> 5] & mask) || (_rtcBlock.ambiguous[slot >> 5] & mask)) return false;
+    state = _rtcBlock.states[slot >> 5] & mask;
+    return true;
+}
+
+void RTCStateMirror::set(int8_t slot, bool state) {
+    if (slot < 0 || slot >= RTC_STATE_MAX_DEVICES) return;
+    uint8_t word = slot >> 5;
+    uint32_t mask = 1UL << (slot & 31);
+    _lock.enter();
+    if (!(_rtcBlock.ambiguous[word] & mask) && ((_rtcBlock.states[word] & mask) != 0) != state) {
+        if (state) {
+            _rtcBlock.states[word] |= mask;
+        } else {
+            _rtcBlock.states[word] &= ~mask;
+        }
+        _rtcBlock.check = ~_sum(_rtcBlock);
+        _commit(word);
+    }
+    _lock.exit();
+}
+
+void RTCStateMirror::_load() {
+    if (_loaded) return;
+    _loaded = true;
+    bool coldBoot = false;
+#if defined(ESP32)
+    esp_reset_reason_t reason = esp_reset_reason();
+    coldBoot = reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT;
+#elif defined(ESP8266)
+    coldBoot = ESP.getResetInfoPtr()->reason == REASON_DEFAULT_RST;
+    ESP.rtcUserMemoryRead(RTC_STATE_OFFSET, reinterpret_cast<uint32_t *>(&_rtcBlock), sizeof(_rtcBlock));
+#endif
+    if (coldBoot || _rtcBlock.magic != RTC_STATE_MAGIC || _rtcBlock.count > RTC_STATE_MAX_DEVICES ||
+        _rtcBlock.check != ~_sum(_rtcBlock)) {
+        _reset();
+        return;
+    }
+    _warm = true;
+    for (uint32_t i = 0; i < _rtcBlock.count; i++) {
+        _restored[i >> 5] |= 1UL << (i & 31);
+    }
+}
+
+void RTCStateMirror::_reset() {
+    memset(&_rtcBlock, 0, sizeof(_rtcBlock));
+    _rtcBlock.magic = RTC_STATE_MAGIC;
+    _rtcBlock.check = ~_sum(_rtcBlock);
+#if defined(ESP8266)
+    ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, reinterpret_cast<uint32_t *>(&_rtcBlock), sizeof(_rtcBlock));
+#endif
+}
+
+void RTCStateMirror::_commit(uint8_t word) {
+#if defined(ESP8266)
+    // only the changed state word and the check, RTC user memory is written in 4-byte blocks
+    ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET + offsetof(rtc_state_block_t, states) / 4 + word,
+                           &_rtcBlock.states[word], 4);
+    ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET + offsetof(rtc_state_block_t, check) / 4, &_rtcBlock.check, 4);
+#else
+    (void) word; // the block itself lives in RTC memory
+#endif
+}
+
+uint32_t RTCStateMirror::_sum(const rtc_state_block_t &block) {
+    const auto *words = reinterpret_cast<const uint32_t *>(&block);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(rtc_state_block_t, check) / 4; i++) {
+        sum += words[i];
+    }
+    return sum;
+}
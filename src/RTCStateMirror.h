@@ -0,0 +1,91 @@
+#ifndef RTCSTATEMIRROR_H
+#define RTCSTATEMIRROR_H
+
+#include <Arduino.h>
+#include <cstddef>
+#include "DeviceLibTypes.h"
+#include "CriticalSection.h"
+
+/* Devices mirrored in RTC memory */
+#ifndef RTC_STATE_MAX_DEVICES
+#define RTC_STATE_MAX_DEVICES 48
+#endif
+
+/* ESP8266: offset in RTC user memory, in 4-byte blocks. The first 128 bytes are left to OTA */
+#ifndef RTC_STATE_OFFSET
+#define RTC_STATE_OFFSET 32
+#endif
+
+#define RTC_STATE_WORDS ((RTC_STATE_MAX_DEVICES + 31) / 32)
+#define RTC_STATE_MAGIC 0x32545452UL // "RTT2", 32-bit key hashes
+
+struct rtc_state_block_t {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t keys[RTC_STATE_MAX_DEVICES]; // key hash per slot
+    uint32_t states[RTC_STATE_WORDS];
+    uint32_t ambiguous[RTC_STATE_WORDS]; // slots claimed by two keys with the same hash, never restored
+    uint32_t check; // inverted sum of every word above
+};
+
+/**
+ * @brief Packed copy of the output states in memory that survives a software reset
+ * (RTC user memory on ESP8266, RTC_NOINIT RAM on ESP32).
+ *
+ * It is updated together with every state write. After a watchdog, OTA or software reset the
+ * constructors read their state back from it and drive the pins immediately, without waiting
+ * for the filesystem. On a cold power-on (or an invalid checksum) it is reset and the
+ * flash store is used as before.
+ */
+class RTCStateMirror {
+public:
+    constexpr RTCStateMirror() = default;
+
+    /**
+     * @brief Find or allocate the slot of a device
+     * @param key device key
+     * @return slot, -1 if the mirror is full or the key hash is already taken by another device
+     */
+    int8_t add(const String &key);
+
+    /**
+     * @brief Get the state kept for a device across the last reset
+     * @param slot from add()
+     * @param state output
+     * @return false on a cold boot, if the device was not mirrored or if its slot is ambiguous
+     */
+    bool restore(int8_t slot, bool &state);
+
+    /**
+     * @brief Update the state of a device
+     * @param slot from add()
+     * @param state
+     */
+    void set(int8_t slot, bool state);
+
+    /**
+     * @brief true if the mirror survived the last reset
+     */
+    bool isWarmBoot() {
+        _load();
+        return _warm;
+    }
+
+private:
+    bool _loaded = false;
+    bool _warm = false;
+    uint32_t _restored[RTC_STATE_WORDS] = {}; // slots valid before this boot
+    uint32_t _claimed[RTC_STATE_WORDS] = {}; // slots returned by add() since this boot
+    CriticalSection _lock;
+
+    void _load();
+
+    void _reset();
+
+    void _commit(uint8_t word);
+
+    static uint32_t _sum(const rtc_state_block_t &block);
+};
+
+
+#endif //RTCSTATEMIRROR_H
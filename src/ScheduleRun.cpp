@@ -0,0 +1,132 @@
+#include "ScheduleRun.h"
+
+
+void schedule_histogram_t::add(uint32_t us) {
+    count++;
+    lastUs = us;
+    totalUs += us;
+    if (us > maxUs) maxUs = us;
+    uint8_t bucket = 0;
+    while (bucket + 1 < SCHEDULE_HISTOGRAM_BUCKETS && us >= bucketLimitUs(bucket)) bucket++;
+    buckets[bucket]++;
+}
+
+
+void ScheduleRun::_execute(schedule_entry_t &entry, size_t depth) {
+    uint32_t start = micros();
+    if (entry.fn != nullptr) {
+        entry.fn(); // run the schedule
+    }
+    uint32_t exec = (uint32_t) micros() - start;
+    // one critical section per callback: getStats() copies a consistent set from any task
+    _lock.enter();
+    _stats.latency.add(start - entry.queuedUs);
+    if (depth > _stats.highWater) _stats.highWater = depth;
+    _stats.dispatched++;
+    _stats.exec.add(exec);
+    _lock.exit();
+
+    if (entry.tag != nullptr) {
+        // the tag is a static string, same site same pointer
+        for (auto &site: _tagStats) {
+            if (site.tag != entry.tag && site.tag != nullptr) continue;
+            site.tag = entry.tag;
+            site.count++;
+            site.totalUs += exec;
+            if (exec > site.maxUs) site.maxUs = exec;
+            break;
+        }
+    }
+    if (_slowListener != nullptr && exec >= _slowUs) {
+        _slowListener(entry.tag, exec, _slowArg);
+    }
+}
+
+bool ScheduleRun::addKeyedSchedule(const void *owner, uint8_t kind, devlib_function_t schedule,
+                                   schedule_lane_t lane, const char *tag) {
+    schedule_keyed_t *slot = nullptr;
+    _lock.enter();
+    for (auto &keyed: _keyed) {
+        if (keyed.owner == owner && keyed.kind == kind) {
+            // pending: the latest callable wins, the place in the lane is kept
+            keyed.fn = std::move(schedule);
+            keyed.tag = tag;
+            keyed.coalesced = true;
+            _stats.coalesced++;
+            _lock.exit();
+            return true;
+        }
+        if (slot == nullptr && keyed.owner == nullptr) slot = &keyed;
+    }
+    if (slot != nullptr) {
+        slot->owner = owner;
+        slot->kind = kind;
+        slot->fn = std::move(schedule);
+        slot->tag = tag;
+        slot->coalesced = false;
+    }
+    _lock.exit();
+    if (slot == nullptr) {
+        // coalescing is an optimisation: never lose the callback for it
+        return addSchedule(std::move(schedule), lane, tag);
+    }
+    if (!addSchedule([this, slot]() { _runKeyed(slot); }, lane, tag)) {
+        _lock.enter();
+        bool coalesced = slot->coalesced;
+        devlib_function_t fn = std::move(slot->fn);
+        slot->fn = nullptr;
+        slot->owner = nullptr;
+        _lock.exit();
+        // a producer coalesced into the slot meanwhile and got true: its callable is the one
+        // stored, give it a place of its own
+        return coalesced && addSchedule(std::move(fn), lane, tag);
+    }
+    return true;
+}
+
+void ScheduleRun::_runKeyed(schedule_keyed_t *slot) {
+    devlib_function_t fn;
+    _lock.enter();
+    fn = std::move(slot->fn);
+    slot->fn = nullptr;
+    slot->owner = nullptr; // schedules from now on take a new place
+    _lock.exit();
+    if (fn != nullptr) fn();
+}
+
+void ScheduleRun::_countRefused(schedule_lane_t lane) {
+    _lock.enter();
+    if (lane == SCHEDULE_LANE_BACKGROUND) {
+        _stats.shed++;
+    } else {
+        _stats.dropped++;
+    }
+    _lock.exit();
+    // no print: this runs in ISRs and timer callbacks, the drops are in getStats()
+}
+
+schedule_stats_t ScheduleRun::getStats() const {
+    _lock.enter();
+    schedule_stats_t stats = _stats;
+    _lock.exit();
+    stats.depth = size();
+    return stats;
+}
+
+size_t ScheduleRun::getTagStats(schedule_tag_stats_t *out, size_t max) const {
+    size_t n = 0;
+    for (const auto &site: _tagStats) {
+        if (site.tag == nullptr || n >= max) break;
+        out[n++] = site;
+    }
+    return n;
+}
+
+void ScheduleRun::resetStats() {
+    _lock.enter();
+    _stats = schedule_stats_t();
+    _lock.exit();
+    for (auto &site: _tagStats) {
+        site = schedule_tag_stats_t();
+    }
+}
@@ -2,92 +2,400 @@
 #define SCHEDULERUN_H
 
 #include "Arduino.h"
+#include "DeviceLibTypes.h"
+#include "MPSCRing.h"
+#include "CriticalSection.h"
+
 #if defined(ESP32)
-#include <freertos/queue.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #endif
 
 #define MAX_SCHEDULES 20
 
+/* Slots of the background lane */
+#ifndef MAX_BACKGROUND_SCHEDULES
+#define MAX_BACKGROUND_SCHEDULES 8
+#endif
+
+/* Pending keyed schedules, see ScheduleRun::addKeyedSchedule(). Each one holds a place in a lane,
+ * so with one slot per lane place a key never runs out of slots before its lane is full */
+#ifndef MAX_KEYED_SCHEDULES
+#define MAX_KEYED_SCHEDULES (MAX_SCHEDULES + MAX_BACKGROUND_SCHEDULES)
+#endif
+
+/**
+ * @brief Kind of deferred work of a device, the second half of a schedule key
+ */
+enum schedule_kind_t : uint8_t {
+    SCHEDULE_KIND_EDGE = 0, // on/off (active/inactive) callback, the latest one replaces the pending one
+    SCHEDULE_KIND_CHANGE,   // state changed callback
+    SCHEDULE_KIND_OUTPUT,   // output function of a virtual device
+    SCHEDULE_KIND_USER = 16 // first kind free for sketches
+};
+
+enum schedule_lane_t : uint8_t {
+    SCHEDULE_LANE_CRITICAL = 0, // device callbacks and expander I/O
+    SCHEDULE_LANE_BACKGROUND    // cloud pushes, flash writes: run after the critical lane, shed when full
+};
+
+#if defined(ESP32)
+
+/* Dispatcher task, see ScheduleRun::startTask() */
+#ifndef SCHEDULE_TASK_STACK
+#define SCHEDULE_TASK_STACK 4096
+#endif
+
+/* Above loopTask (1), so callbacks preempt a busy loop() */
+#ifndef SCHEDULE_TASK_PRIORITY
+#define SCHEDULE_TASK_PRIORITY 2
+#endif
+
+#ifndef SCHEDULE_TASK_CORE
+#define SCHEDULE_TASK_CORE tskNO_AFFINITY
+#endif
+
+#endif // ESP32
+
+/* Histogram buckets, bucket i counts values below 64 << 2i us, the last one the rest */
+#define SCHEDULE_HISTOGRAM_BUCKETS 8
+
+/* Tagged registration sites with their own execution stats */
+#ifndef SCHEDULE_TAG_STATS
+#define SCHEDULE_TAG_STATS 16
+#endif
+
+/**
+ * @brief Distribution of durations in microseconds
+ */
+struct schedule_histogram_t {
+    uint32_t count = 0;
+    uint32_t lastUs = 0;
+    uint32_t maxUs = 0;
+    uint64_t totalUs = 0;
+    uint32_t buckets[SCHEDULE_HISTOGRAM_BUCKETS] = {};
+
+    void add(uint32_t us);
+
+    uint32_t averageUs() const {
+        return count > 0 ? (uint32_t) (totalUs / count) : 0;
+    }
+
+    /**
+     * @brief Upper bound of a bucket (excluded), UINT32_MAX for the last one
+     */
+    static uint32_t bucketLimitUs(uint8_t bucket) {
+        return bucket + 1 < SCHEDULE_HISTOGRAM_BUCKETS ? 64UL << (2 * bucket) : UINT32_MAX;
+    }
+};
+
+/**
+ * @brief Execution time of the callbacks of one registration site
+ */
+struct schedule_tag_stats_t {
+    const char *tag = nullptr;
+    uint32_t count = 0;
+    uint32_t maxUs = 0;
+    uint64_t totalUs = 0;
+
+    uint32_t averageUs() const {
+        return count > 0 ? (uint32_t) (totalUs / count) : 0;
+    }
+};
+
+/**
+ * @brief Snapshot of the scheduler counters
+ */
+struct schedule_stats_t {
+    uint32_t dispatched = 0;     // schedules run
+    uint32_t dropped = 0;        // critical schedules refused, the lane was full
+    uint32_t shed = 0;           // background schedules refused, the lane was full
+    uint32_t coalesced = 0;      // keyed schedules merged into a pending one
+    uint16_t depth = 0;          // schedules queued now
+    uint16_t highWater = 0;      // most schedules queued at once
+    schedule_histogram_t latency; // addSchedule() to the start of the callback
+    schedule_histogram_t exec;    // execution time of the callbacks
+};
+
+/**
+ * @brief Called after a callback that ran longer than the slow threshold
+ * @param tag registration site, nullptr if untagged
+ * @param execUs execution time
+ */
+typedef void (*schedule_slow_listener_t)(const char *tag, uint32_t execUs, void *arg);
+
+struct schedule_entry_t {
+    devlib_function_t fn;
+    uint32_t queuedUs = 0;   // micros() of addSchedule()
+    const char *tag = nullptr;
+
+    schedule_entry_t() = default;
+
+    schedule_entry_t(devlib_function_t &&fn, uint32_t queuedUs, const char *tag)
+        : fn(std::move(fn)), queuedUs(queuedUs), tag(tag) {}
+};
+
+/**
+ * @brief Pending schedule of a (owner, kind) key
+ */
+struct schedule_keyed_t {
+    const void *owner = nullptr; // nullptr when the slot is free
+    uint8_t kind = 0;
+    devlib_function_t fn;
+    const char *tag = nullptr;
+    bool coalesced = false; // fn was replaced by a later schedule of the key
+};
+
 class ScheduleRun {
 private:
-#if defined(ESP8266)
-    std::function<void()> scheduleArr[MAX_SCHEDULES];
-#elif defined(ESP32)
-    QueueHandle_t scheduleQueue;
-#endif
-public:
+    MPSCRing<schedule_entry_t, MAX_SCHEDULES> scheduleRing;
+    MPSCRing<schedule_entry_t, MAX_BACKGROUND_SCHEDULES> backgroundRing;
+    schedule_stats_t _stats;
+    schedule_tag_stats_t _tagStats[SCHEDULE_TAG_STATS];
+    uint32_t _slowUs = 0;
+    schedule_slow_listener_t _slowListener = nullptr;
+    void *_slowArg = nullptr;
+    mutable CriticalSection _lock; // stats, keyed slots
+    schedule_keyed_t _keyed[MAX_KEYED_SCHEDULES];
 
     /**
-     *
-     * @param maxSchedules 0 for unlimited schedules
+     * @brief Run the schedule at the head of a lane
+     * @return false if the lane is empty
      */
-    ScheduleRun() {
-#if defined(ESP32)
-        scheduleQueue = xQueueCreate(MAX_SCHEDULES, sizeof(std::function<void()>));
-#endif
+    template<typename Ring>
+    bool _dispatch(Ring &ring) {
+        size_t depth = size();
+        schedule_entry_t entry;
+        if (!ring.pop(entry)) return false;
+        _execute(entry, depth);
+        return true;
     }
 
-    ~ScheduleRun() {
+    /**
+     * @brief Run a schedule and record its stats
+     * @param depth schedules queued before it was popped
+     */
+    void _execute(schedule_entry_t &entry, size_t depth);
+
+    /**
+     * @brief Count a schedule its lane refused (dropped or shed). Safe from ISR
+     */
+    void _countRefused(schedule_lane_t lane);
+
+    /**
+     * @brief Ring entry of a keyed schedule: free the slot, then run its latest callable
+     */
+    void _runKeyed(schedule_keyed_t *slot);
+
 #if defined(ESP32)
-        if (scheduleQueue != nullptr) {
-            vQueueDelete(scheduleQueue);
-            scheduleQueue = nullptr;
+    TaskHandle_t _task = nullptr;
+    volatile bool _taskStop = false;
+
+    /**
+     * @brief Wake the dispatcher task, from a task or an ISR
+     */
+    void _notifyTask() {
+        TaskHandle_t task = _task;
+        if (task == nullptr) return;
+        if (xPortInIsrContext()) {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(task, &woken);
+            if (woken) portYIELD_FROM_ISR();
+        } else {
+            xTaskNotifyGive(task);
         }
-#elif defined(ESP8266)
-        for (auto &s : scheduleArr) {
-            s = nullptr; // clear the schedule array
+    }
+
+    static void _taskLoop(void *arg) {
+        auto *self = static_cast<ScheduleRun *>(arg);
+        while (!self->_taskStop) {
+            self->run();
+            // one notification per addSchedule(), the ones taken during run() are drained for free
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         }
+        self->_task = nullptr;
+        vTaskDelete(nullptr);
+    }
 #endif
+public:
+
+    /**
+     * @brief Scheduled callbacks are kept in a lock-free ring of MAX_SCHEDULES slots
+     * (rounded up to a power of two)
+     */
+    constexpr ScheduleRun() = default;
+
+    ~ScheduleRun() {
+        scheduleRing.clear();
+        backgroundRing.clear();
     }
 
+    ScheduleRun(const ScheduleRun &) = delete;
+
+    ScheduleRun &operator=(const ScheduleRun &) = delete;
+
     /**
      * @brief Add a schedule to the list
+     *
+     * Safe to call from tasks, timer callbacks and ISRs. The callable is stored inline, nothing is allocated.
      * @param schedule
+     * @param lane SCHEDULE_LANE_BACKGROUND for work that can wait (and be dropped) under load
+     * @param tag registration site in the stats (static string), e.g. "p13.onPowerOn"
+     * @return false if the lane is full
      */
-    void addSchedule(std::function<void()> schedule) {
-#if defined(ESP32)
-        if (scheduleQueue == nullptr) return;
-        if (xQueueSend(scheduleQueue, &schedule, 0) != pdTRUE) {
-            Serial.println("[Err][ScheduleRun] Failed to add schedule to queue");
-        }
-#elif defined(ESP8266)
-        for (auto &s : scheduleArr) {
-            if (s == nullptr) {
-                s = schedule;
-                return;
-            }
+    bool addSchedule(devlib_function_t schedule, schedule_lane_t lane = SCHEDULE_LANE_CRITICAL,
+                     const char *tag = nullptr) {
+        uint32_t now = micros();
+        bool added = lane == SCHEDULE_LANE_BACKGROUND
+                     ? backgroundRing.emplace(std::move(schedule), now, tag)
+                     : scheduleRing.emplace(std::move(schedule), now, tag);
+        if (!added) {
+            _countRefused(lane);
+            return false;
         }
+#if defined(ESP32)
+        _notifyTask();
 #endif
+        return true;
     }
 
     /**
-     * @brief Run all schedules and remove them from the list
+     * @brief Add a function pointer with a context argument to the list
+     * @param fn
+     * @param context
+     * @param lane
+     * @param tag registration site in the stats (static string), e.g. "p13.onPowerOn"
+     * @return false if the lane is full
      */
-    void run() {
+    bool addSchedule(devlib_function_t::context_fn_t fn, void *context, schedule_lane_t lane = SCHEDULE_LANE_CRITICAL,
+                     const char *tag = nullptr) {
+        return addSchedule(devlib_function_t(fn, context), lane, tag);
+    }
+
+    /**
+     * @brief Add a schedule that replaces the pending one with the same key
+     *
+     * The first schedule of a key takes a place in its lane; until it runs, later schedules of the
+     * key only replace its callable. A burst of changes on one device therefore runs once, with the
+     * latest callable, at the place of the first one. Without a free keyed slot the schedule is
+     * added unkeyed. Safe from ISR.
+     * @param owner device (or any object) the work belongs to
+     * @param kind schedule_kind_t, or SCHEDULE_KIND_USER and above
+     * @param schedule
+     * @param lane
+     * @param tag registration site in the stats (static string)
+     * @return false if the lane is full
+     */
+    bool addKeyedSchedule(const void *owner, uint8_t kind, devlib_function_t schedule,
+                          schedule_lane_t lane = SCHEDULE_LANE_CRITICAL, const char *tag = nullptr);
+
+    /**
+     * @brief Run the schedules queued so far and remove them from the list
+     *
+     * The critical lane goes first: it is checked again before every background schedule.
+     * Schedules added while running wait for the next run, so a callback that schedules itself
+     * can not starve loop(). Does nothing outside the dispatcher task while it runs, so loop()
+     * can keep calling it.
+     * @param budgetUs stop once this time is spent, the rest stays queued
+     * @return true if both lanes are empty
+     */
+    bool run(uint32_t budgetUs = UINT32_MAX) {
 #if defined(ESP32)
-        if (scheduleQueue == nullptr) return;
-        std::function<void()> schedule;
-        while (xQueueReceive(scheduleQueue, &schedule, 0) == pdTRUE) {
-            if (schedule != nullptr) {
-                schedule(); // run the schedule
-            }
-        }
-#elif defined(ESP8266)
-        std::function<void()> pending[20];
-        uint8_t count = 0;
-        for (auto &schedule : scheduleArr) {
-            if (schedule != nullptr) {
-                pending[count++] = schedule;
-                schedule = nullptr; // clear the schedule after running
-            }
+        // the dispatcher task is then the only consumer
+        TaskHandle_t task = _task;
+        if (task != nullptr && xTaskGetCurrentTaskHandle() != task) return false;
+#endif
+        uint32_t start = micros();
+        size_t pending = scheduleRing.size() + backgroundRing.size();
+        for (; pending > 0; pending--) {
+            if (!_dispatch(scheduleRing) && !_dispatch(backgroundRing)) break;
+            if ((uint32_t) micros() - start >= budgetUs) break;
         }
-        for (uint8_t i = 0; i < count; i++) {
-            if (pending[i] != nullptr) {
-                pending[i]();
-            }
+        return empty();
+    }
+
+    /**
+     * @brief Approximate number of queued schedules in both lanes
+     */
+    size_t size() const {
+        return scheduleRing.size() + backgroundRing.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Copy of the counters and histograms, cheap enough to publish periodically
+     */
+    schedule_stats_t getStats() const;
+
+    /**
+     * @brief Execution stats of the tagged registration sites
+     * @param out
+     * @param max entries of out
+     * @return entries copied
+     */
+    size_t getTagStats(schedule_tag_stats_t *out, size_t max) const;
+
+    /**
+     * @brief Clear the counters, histograms and tag stats. Call from the consumer (loop() or a callback)
+     */
+    void resetStats();
+
+    /**
+     * @brief Report the callbacks that run longer than a threshold
+     * @param thresholdUs
+     * @param listener nullptr to disable, runs in the consumer after the slow callback
+     * @param arg
+     */
+    void setSlowListener(uint32_t thresholdUs, schedule_slow_listener_t listener, void *arg = nullptr) {
+        _slowUs = thresholdUs;
+        _slowListener = listener;
+        _slowArg = arg;
+    }
+
+#if defined(ESP32)
+
+    /**
+     * @brief Dispatch from a dedicated task instead of loop()
+     *
+     * The task blocks until addSchedule() wakes it, so callbacks run as soon as they are queued
+     * even while loop() is blocked (TLS handshake, cloud sync). Callbacks then run concurrently
+     * with loop(): state shared with the sketch needs its own locking.
+     * @param priority FreeRTOS priority, above loopTask (1) by default
+     * @param core core to pin the task to, tskNO_AFFINITY for any
+     * @param stackSize bytes
+     * @return false if the task could not be created
+     */
+    bool startTask(UBaseType_t priority = SCHEDULE_TASK_PRIORITY, BaseType_t core = SCHEDULE_TASK_CORE,
+                   uint32_t stackSize = SCHEDULE_TASK_STACK) {
+        if (_task != nullptr) return true;
+        _taskStop = false;
+        // the handle is stored before the task can run, run() sees it from the first iteration
+        if (xTaskCreatePinnedToCore(_taskLoop, "devlib_sched", stackSize, this, priority, &_task, core) != pdPASS) {
+            _task = nullptr;
+            Serial.println("[Err][ScheduleRun] Failed to create the dispatcher task");
+            return false;
         }
-#endif
+        return true;
     }
+
+    /**
+     * @brief Stop the dispatcher task after its current run, loop() has to call run() again
+     */
+    void stopTask() {
+        TaskHandle_t task = _task;
+        if (task == nullptr) return;
+        _taskStop = true;
+        xTaskNotifyGive(task);
+    }
+
+    bool hasTask() const {
+        return _task != nullptr;
+    }
+
+#endif // ESP32
 };
 
 
@@ -0,0 +1,230 @@
+#include "StateJournal.h"
+
+#define JOURNAL_SCAN_CHUNK 16
+
+/* ================ Storage ================ */
+
+#if defined(ESP32) || defined(ESP8266)
+
+bool FileJournalStorage::open(uint32_t size) {
+    if (!_fs.exists(_path)) {
+        fs::File created = _fs.open(_path, "w");
+        if (!created) return false;
+        created.close();
+    }
+    _file = _fs.open(_path, "r+");
+    if (!_file) return false;
+    if (_file.size() < size) {
+        // preallocate with zeros, a zeroed record never passes the check
+        uint8_t zeros[32] = {};
+        _file.seek(_file.size());
+        for (uint32_t left = size - _file.size(); left > 0;) {
+            size_t n = left < sizeof(zeros) ? left : sizeof(zeros);
+            if (_file.write(zeros, n) != n) return false;
+            left -= n;
+        }
+        _file.flush();
+    }
+    return true;
+}
+
+bool FileJournalStorage::read(uint32_t offset, void *buf, size_t len) {
+    if (!_file || !_file.seek(offset)) return false;
+    return _file.read(static_cast<uint8_t *>(buf), len) == len;
+}
+
+bool FileJournalStorage::write(uint32_t offset, const void *buf, size_t len) {
+    if (!_file || !_file.seek(offset)) return false;
+    return _file.write(static_cast<const uint8_t *>(buf), len) == len;
+}
+
+#else
+
+bool StdioJournalStorage::open(uint32_t size) {
+    if (_file != nullptr) fclose(_file); // retry after a failed open
+    _file = fopen(_path, "r+b");
+    if (_file == nullptr) _file = fopen(_path, "w+b");
+    if (_file == nullptr) return false;
+    fseek(_file, 0, SEEK_END);
+    long current = ftell(_file);
+    if (current < (long) size) {
+        uint8_t zeros[32] = {};
+        for (uint32_t left = size - current; left > 0;) {
+            size_t n = left < sizeof(zeros) ? left : sizeof(zeros);
+            if (fwrite(zeros, 1, n, _file) != n) return false;
+            left -= n;
+        }
+        fflush(_file);
+    }
+    return true;
+}
+
+bool StdioJournalStorage::read(uint32_t offset, void *buf, size_t len) {
+    if (_file == nullptr || fseek(_file, offset, SEEK_SET) != 0) return false;
+    return fread(buf, 1, len, _file) == len;
+}
+
+bool StdioJournalStorage::write(uint32_t offset, const void *buf, size_t len) {
+    if (_file == nullptr || fseek(_file, offset, SEEK_SET) != 0) return false;
+    return fwrite(buf, 1, len, _file) == len;
+}
+
+#endif
+
+
+
+/* ================ Journal ================ */
+
+bool StateJournal::begin() {
+    if (_ready) return true;
+    if (!_storage.open(_recordOffset(JOURNAL_RING_RECORDS))) {
+        Serial.println("[Err][StateJournal] Failed to open storage");
+        return false;
+    }
+    _ready = true;
+
+    /* newest valid snapshot */
+    journal_snapshot_t snapshot;
+    bool found = false;
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        journal_snapshot_t candidate;
+        if (!_storage.read(_snapshotOffset(slot), &candidate, sizeof(candidate))) continue;
+        if (candidate.magic != JOURNAL_MAGIC || candidate.count > JOURNAL_MAX_DEVICES) continue;
+        if (candidate.check != _snapshotCheck(candidate)) continue;
+        if (!found || (int32_t) (candidate.seq - snapshot.seq) > 0) {
+            snapshot = candidate;
+            _activeSnapshot = slot;
+            found = true;
+        }
+    }
+    if (found) {
+        _count = snapshot.count;
+        memcpy(_keys, snapshot.keys, sizeof(_keys));
+        memcpy(_states, snapshot.states, sizeof(_states));
+        _seq = snapshot.seq;
+    }
+
+    /* replay the ring: records continuing the snapshot sequence, stop at the first gap */
+    journal_record_t records[JOURNAL_SCAN_CHUNK];
+    uint16_t pos = 0;
+    bool done = false;
+    while (!done && pos < JOURNAL_RING_RECORDS) {
+        uint16_t n = JOURNAL_RING_RECORDS - pos;
+        if (n > JOURNAL_SCAN_CHUNK) n = JOURNAL_SCAN_CHUNK;
+        if (!_storage.read(_recordOffset(pos), records, n * sizeof(journal_record_t))) break;
+        for (uint16_t i = 0; i < n; i++) {
+            const journal_record_t &record = records[i];
+            if (record.check != _recordCheck(record) || record.seq != _seq + 1) {
+                done = true;
+                break;
+            }
+            _apply(record.key, record.state);
+            _seq = record.seq;
+            _stats.recovered++;
+            pos++;
+        }
+    }
+    _ringPos = pos;
+    return true;
+}
+
+bool StateJournal::set(const String &key, bool state) {
+    if (!begin()) return false;
+    uint32_t hash = hashKey(key);
+    int16_t index = _findOrAdd(hash);
+    if (index < 0) {
+        Serial.printf("[Err][StateJournal] No slot for %s\n", key.c_str());
+        return false;
+    }
+    if (((_states[index >> 5] >> (index & 31)) & 1) == state) return true;
+    if (_ringPos >= JOURNAL_RING_RECORDS && !compact()) return false;
+    journal_record_t record = {_seq + 1, hash, state, {}, 0};
+    record.check = _recordCheck(record);
+    if (!_storage.write(_recordOffset(_ringPos), &record, sizeof(record))) return false;
+    _storage.sync();
+    _ringPos++;
+    _seq = record.seq;
+    _apply(hash, state);
+    _stats.appended++;
+    return true;
+}
+
+bool StateJournal::getBool(const String &key, bool defaultValue) {
+    if (!begin()) return defaultValue;
+    int16_t index = _find(hashKey(key));
+    if (index < 0) return defaultValue;
+    return (_states[index >> 5] >> (index & 31)) & 1;
+}
+
+bool StateJournal::compact() {
+    if (!begin()) return false;
+    journal_snapshot_t snapshot = {};
+    snapshot.magic = JOURNAL_MAGIC;
+    snapshot.seq = _seq;
+    snapshot.count = _count;
+    memcpy(snapshot.keys, _keys, sizeof(_keys));
+    memcpy(snapshot.states, _states, sizeof(_states));
+    snapshot.check = _snapshotCheck(snapshot);
+    uint8_t slot = _activeSnapshot ^ 1;
+    if (!_storage.write(_snapshotOffset(slot), &snapshot, sizeof(snapshot))) return false;
+    _storage.sync();
+    // records of the previous lap are older than the snapshot and stop the replay
+    _activeSnapshot = slot;
+    _ringPos = 0;
+    _stats.compactions++;
+    return true;
+}
+
+uint32_t StateJournal::hashKey(const String &key) {
+    return devlib_key_hash(key.c_str());
+}
+
+int16_t StateJournal::_find(uint32_t key) const {
+    for (uint16_t i = 0; i < _count; i++) {
+        if (_keys[i] == key) return (int16_t) i;
+    }
+    return -1;
+}
+
+int16_t StateJournal::_findOrAdd(uint32_t key) {
+    int16_t index = _find(key);
+    if (index >= 0 || _count >= JOURNAL_MAX_DEVICES) return index;
+    _keys[_count] = key;
+    return (int16_t) _count++;
+}
+
+void StateJournal::_apply(uint32_t key, bool state) {
+    int16_t index = _findOrAdd(key);
+    if (index < 0) return;
+    if (state) {
+        _states[index >> 5] |= 1UL << (index & 31);
+    } else {
+        _states[index >> 5] &= ~(1UL << (index & 31));
+    }
+}
+
+uint8_t StateJournal::_recordCheck(const journal_record_t &record) {
+    // CRC-8 over the record without the check byte. Inverted so an erased/zeroed record is never valid
+    const auto *data = reinterpret_cast<const uint8_t *>(&record);
+    uint8_t crc = 0;
+    for (size_t i = 0; i < offsetof(journal_record_t, check); i++) {
+        crc ^= data[i];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc ^ 0xA5;
+}
+
+uint16_t StateJournal::_snapshotCheck(const journal_snapshot_t &snapshot) {
+    // Fletcher-16 over the snapshot with the check field as 0
+    journal_snapshot_t copy = snapshot;
+    copy.check = 0;
+    const auto *data = reinterpret_cast<const uint8_t *>(&copy);
+    uint16_t sum1 = 0, sum2 = 0;
+    for (size_t i = 0; i < sizeof(copy); i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
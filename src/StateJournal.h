@@ -0,0 +1,203 @@
+#ifndef STATEJOURNAL_H
+#define STATEJOURNAL_H
+
+#include <Arduino.h>
+#include <cstddef>
+#include "DeviceLibTypes.h"
+
+#if defined(ESP32) || defined(ESP8266)
+#include <FS.h>
+#include <LittleFS.h>
+#else
+#include <cstdio>
+#endif
+
+/* Devices tracked by the journal */
+#ifndef JOURNAL_MAX_DEVICES
+#define JOURNAL_MAX_DEVICES 64
+#endif
+
+/* Records in the ring before it is compacted into a snapshot */
+#ifndef JOURNAL_RING_RECORDS
+#define JOURNAL_RING_RECORDS 512
+#endif
+
+#define JOURNAL_WORDS ((JOURNAL_MAX_DEVICES + 31) / 32)
+#define JOURNAL_MAGIC 0x324A5344UL // "DSJ2", 32-bit key hashes
+
+/**
+ * @brief Random access storage behind the journal (a preallocated file)
+ */
+class JournalStorage {
+public:
+    virtual ~JournalStorage() = default;
+
+    /**
+     * @brief Open the storage and make sure it is at least `size` bytes
+     */
+    virtual bool open(uint32_t size) = 0;
+
+    virtual bool read(uint32_t offset, void *buf, size_t len) = 0;
+
+    virtual bool write(uint32_t offset, const void *buf, size_t len) = 0;
+
+    virtual void sync() {}
+};
+
+#if defined(ESP32) || defined(ESP8266)
+
+/**
+ * @brief Journal storage on a LittleFS file
+ */
+class FileJournalStorage : public JournalStorage {
+public:
+    explicit FileJournalStorage(const char *path, fs::FS &fs = LittleFS) : _path(path), _fs(fs) {}
+
+    bool open(uint32_t size) override;
+
+    bool read(uint32_t offset, void *buf, size_t len) override;
+
+    bool write(uint32_t offset, const void *buf, size_t len) override;
+
+    void sync() override {
+        if (_file) _file.flush();
+    }
+
+private:
+    const char *_path;
+    fs::FS &_fs;
+    fs::File _file;
+};
+
+#else
+
+/**
+ * @brief Journal storage on a stdio file, stand-in for LittleFS on the host
+ */
+class StdioJournalStorage : public JournalStorage {
+public:
+    explicit StdioJournalStorage(const char *path) : _path(path) {}
+
+    ~StdioJournalStorage() override {
+        if (_file != nullptr) fclose(_file);
+    }
+
+    bool open(uint32_t size) override;
+
+    bool read(uint32_t offset, void *buf, size_t len) override;
+
+    bool write(uint32_t offset, const void *buf, size_t len) override;
+
+    void sync() override {
+        if (_file != nullptr) fflush(_file);
+    }
+
+private:
+    const char *_path;
+    FILE *_file = nullptr;
+};
+
+#endif
+
+struct journal_record_t {
+    uint32_t seq;
+    uint32_t key;
+    uint8_t state;
+    uint8_t reserved[2];
+    uint8_t check;
+};
+
+struct journal_snapshot_t {
+    uint32_t magic;
+    uint32_t seq;       // last record folded into the snapshot
+    uint16_t count;
+    uint16_t check;
+    uint32_t keys[JOURNAL_MAX_DEVICES];
+    uint32_t states[JOURNAL_WORDS];
+};
+
+struct journal_stats_t {
+    uint32_t appended = 0;
+    uint32_t compactions = 0;
+    uint32_t recovered = 0; // records replayed at boot
+};
+
+/**
+ * @brief Append-only last-state journal.
+ *
+ * Every state change is one fixed-size record (key hash + state + sequence) appended to a
+ * preallocated ring. When the ring is full, all states are compacted into a bitset snapshot
+ * (two alternating snapshot slots, the newest valid one wins) and the ring restarts.
+ * Boot recovery loads the snapshot and replays the ring in one sequential scan.
+ *
+ * Layout: [snapshot A][snapshot B][JOURNAL_RING_RECORDS records]
+ *
+ * Keys are stored as the 32-bit hash of the device key ("p13", "p5613", ...), devlib_key_hash().
+ */
+class StateJournal {
+public:
+    explicit StateJournal(JournalStorage &storage) : _storage(storage) {}
+
+    /**
+     * @brief Open the storage and recover the states. Called on first use
+     * @return false if the storage can not be opened, the next call tries again
+     */
+    bool begin();
+
+    /**
+     * @brief Append a state change
+     * @return false if the journal is not available or full of devices
+     */
+    bool set(const String &key, bool state);
+
+    /**
+     * @brief Get the last state of a device
+     */
+    bool getBool(const String &key, bool defaultValue = false);
+
+    /**
+     * @brief Fold every state into a snapshot and restart the ring
+     */
+    bool compact();
+
+    journal_stats_t getStats() const {
+        return _stats;
+    }
+
+    /**
+     * @brief Key hash stored in the records
+     */
+    static uint32_t hashKey(const String &key);
+
+private:
+    JournalStorage &_storage;
+    bool _ready = false;
+    uint8_t _activeSnapshot = 0;
+    uint32_t _seq = 0;
+    uint16_t _ringPos = 0;
+    uint16_t _count = 0;
+    uint32_t _keys[JOURNAL_MAX_DEVICES] = {};
+    uint32_t _states[JOURNAL_WORDS] = {};
+    journal_stats_t _stats;
+
+    int16_t _find(uint32_t key) const;
+
+    int16_t _findOrAdd(uint32_t key);
+
+    void _apply(uint32_t key, bool state);
+
+    static uint8_t _recordCheck(const journal_record_t &record);
+
+    static uint16_t _snapshotCheck(const journal_snapshot_t &snapshot);
+
+    static uint32_t _snapshotOffset(uint8_t slot) {
+        return slot * sizeof(journal_snapshot_t);
+    }
+
+    static uint32_t _recordOffset(uint16_t pos) {
+        return 2 * sizeof(journal_snapshot_t) + pos * sizeof(journal_record_t);
+    }
+};
+
+
+#endif //STATEJOURNAL_H
@@ -0,0 +1,341 @@
+#include "TimerWheel.h"
+
+#define TW_ENTER_CRITICAL() _lock.enter()
+#define TW_EXIT_CRITICAL() _lock.exit()
+
+#define TW_MASK (TIMER_WHEEL_SIZE - 1)
+
+
+TimerWheel::~TimerWheel() {
+    _stopDriver();
+#if defined(ESP32)
+    if (_driver != nullptr) {
+        esp_timer_delete(_driver);
+        _driver = nullptr;
+    }
+#if TIMER_WHEEL_ISR
+    if (_taskDriver != nullptr) {
+        esp_timer_stop(_taskDriver);
+        esp_timer_delete(_taskDriver);
+        _taskDriver = nullptr;
+    }
+#endif
+#endif
+}
+
+
+/* ================ Public ================ */
+
+IRAM_ATTR bool TimerWheel::arm(timer_node_t *node, uint32_t ms) {
+    if (node == nullptr) return false;
+    uint32_t ticks = (ms + DEVLIB_TIMER_TICK_MS - 1) / DEVLIB_TIMER_TICK_MS;
+    if (ticks == 0) ticks = 1;
+#if defined(ESP32)
+    if (_driver == nullptr && !xPortInIsrContext()) _createDriver();
+#endif
+    TW_ENTER_CRITICAL();
+    bool deferred = node->deferred;
+    if (node->pprev != nullptr) {
+        _unlink(node);
+    } else {
+        _count++;
+    }
+    // the wheel lags the wall clock while the driver sleeps or runs late: count from the current time
+    uint32_t elapsed = (millis() - _lastMs) / DEVLIB_TIMER_TICK_MS;
+    if (!_running) {
+        // the wheel is empty, nothing to expire on the way
+        _now += elapsed;
+        _lastMs += elapsed * DEVLIB_TIMER_TICK_MS;
+        elapsed = 0;
+    }
+    node->expires = _now + elapsed + ticks;
+    _insert(node);
+    _startDriver(_lastMs + (elapsed + ticks) * DEVLIB_TIMER_TICK_MS);
+    TW_EXIT_CRITICAL();
+    return deferred;
+}
+
+IRAM_ATTR bool TimerWheel::cancel(timer_node_t *node) {
+    if (node == nullptr) return false;
+    TW_ENTER_CRITICAL();
+    bool deferred = node->deferred;
+    if (node->pprev != nullptr) {
+        _unlink(node);
+        _count--;
+    }
+    TW_EXIT_CRITICAL();
+    return deferred;
+}
+
+TIMER_ISR_ATTR void TimerWheel::tick() {
+    uint32_t nowMs = millis();
+    while (nowMs - _lastMs >= DEVLIB_TIMER_TICK_MS) {
+        uint32_t elapsed = (nowMs - _lastMs) / DEVLIB_TIMER_TICK_MS;
+        TW_ENTER_CRITICAL();
+        // jump over the ticks with nothing to expire or cascade
+        uint32_t due = _nextDue();
+        uint32_t skip = due == 0 || due > elapsed ? elapsed : due - 1;
+        _now += skip;
+        _lastMs += skip * DEVLIB_TIMER_TICK_MS;
+        TW_EXIT_CRITICAL();
+        if (skip == elapsed) break;
+        _advance();
+    }
+#if TIMER_WHEEL_ISR
+    if (_deferred != nullptr) {
+#if defined(ESP32)
+        // already started if a previous tick deferred nodes it has not run yet
+        if (_taskDriver != nullptr) esp_timer_start_once(_taskDriver, 0);
+#else
+        _runDeferred(); // host: no ISR, the tick is the task
+#endif
+    }
+#endif
+    TW_ENTER_CRITICAL();
+    uint32_t due = _nextDue();
+    if (due == 0) {
+        _stopDriver();
+    } else {
+        _running = false; // this run used the one-shot
+        _startDriver(_lastMs + due * DEVLIB_TIMER_TICK_MS);
+    }
+    TW_EXIT_CRITICAL();
+}
+
+bool TimerWheel::setIsrDispatch(bool enable) {
+#if TIMER_WHEEL_ISR
+    if (enable == _isr) return true;
+#if defined(ESP32)
+    if (_driver == nullptr) {
+        _isr = enable; // created by the first arm()
+        return true;
+    }
+    // the dispatch method is fixed at creation: recreate the driver
+    TW_ENTER_CRITICAL();
+    bool running = _running;
+    uint32_t driverMs = _driverMs;
+    _stopDriver();
+    TW_EXIT_CRITICAL();
+    if (_driver != nullptr) {
+        esp_timer_delete(_driver);
+        _driver = nullptr;
+    }
+    _isr = enable;
+    _createDriver();
+    TW_ENTER_CRITICAL();
+    if (running) _startDriver(driverMs);
+    TW_EXIT_CRITICAL();
+#else
+    _isr = enable;
+#endif
+    return true;
+#else
+    return !enable;
+#endif
+}
+
+
+
+/* ================ Wheel ================ */
+
+IRAM_ATTR void TimerWheel::_push(timer_node_t **head, timer_node_t *node) {
+    node->next = *head;
+    if (node->next != nullptr) node->next->pprev = &node->next;
+    node->pprev = head;
+    *head = node;
+}
+
+IRAM_ATTR void TimerWheel::_insert(timer_node_t *node) {
+    uint32_t delta = node->expires - _now;
+    uint8_t level = 0;
+    uint32_t slotTick = node->expires;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1UL << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))) {
+        // too far ahead, park it in the last slot of the top level and cascade it again later
+        slotTick = _now + (1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    }
+    _push(&_slots[level][(slotTick >> (TIMER_WHEEL_BITS * level)) & TW_MASK], node);
+}
+
+IRAM_ATTR void TimerWheel::_unlink(timer_node_t *node) {
+    *node->pprev = node->next;
+    if (node->next != nullptr) node->next->pprev = node->pprev;
+    node->next = nullptr;
+    node->pprev = nullptr;
+    node->deferred = false;
+}
+
+TIMER_ISR_ATTR void TimerWheel::_cascade(uint8_t level) {
+    timer_node_t **head = &_slots[level][(_now >> (TIMER_WHEEL_BITS * level)) & TW_MASK];
+    timer_node_t *node = *head;
+    *head = nullptr;
+    while (node != nullptr) {
+        timer_node_t *next = node->next;
+        node->next = nullptr;
+        _insert(node);
+        node = next;
+    }
+}
+
+TIMER_ISR_ATTR void TimerWheel::_advance() {
+    TW_ENTER_CRITICAL();
+    _now++;
+    _lastMs += DEVLIB_TIMER_TICK_MS;
+    for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if ((_now & ((1UL << (TIMER_WHEEL_BITS * level)) - 1)) != 0) break;
+        _cascade(level);
+    }
+    timer_node_t **head = &_slots[0][_now & TW_MASK];
+    while (*head != nullptr) {
+        timer_node_t *node = *head;
+        _unlink(node);
+#if TIMER_WHEEL_ISR
+        if (_isr) {
+            TW_EXIT_CRITICAL();
+            bool needed = node->isr == nullptr || node->isr(node->arg);
+            TW_ENTER_CRITICAL();
+            // re-armed meanwhile: the new expiry wins
+            if (needed && node->pprev == nullptr) {
+                _push(&_deferred, node); // still counted as armed
+                node->deferred = true;
+            } else {
+                _count--;
+            }
+            continue;
+        }
+#endif
+        _count--;
+        TW_EXIT_CRITICAL();
+        // the callback may re-arm or cancel any timer, including this one
+        if (node->callback != nullptr) node->callback(node->arg);
+        TW_ENTER_CRITICAL();
+    }
+    TW_EXIT_CRITICAL();
+}
+
+TIMER_ISR_ATTR uint32_t TimerWheel::_nextDue() const {
+    uint32_t next = 0;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint8_t shift = TIMER_WHEEL_BITS * level;
+        uint32_t index = _now >> shift;
+        // the current slot of a level was cascaded when the wheel entered it, it comes back last
+        for (uint32_t k = 1; k <= TIMER_WHEEL_SIZE; k++) {
+            if (_slots[level][(index + k) & TW_MASK] == nullptr) continue;
+            uint32_t due = ((index + k) << shift) - _now;
+            if (next == 0 || due < next) next = due;
+            break;
+        }
+    }
+    return next;
+}
+
+void TimerWheel::_runDeferred() {
+    TW_ENTER_CRITICAL();
+    while (_deferred != nullptr) {
+        timer_node_t *node = _deferred;
+        _unlink(node);
+        _count--;
+        TW_EXIT_CRITICAL();
+        if (node->callback != nullptr) node->callback(node->arg);
+        TW_ENTER_CRITICAL();
+    }
+    TW_EXIT_CRITICAL();
+}
+
+
+
+/* ================ Driver ================ */
+
+void TimerWheel::_createDriver() {
+#if defined(ESP32)
+    esp_timer_handle_t driver = nullptr;
+    esp_timer_create_args_t timerArgs = {
+        .callback = &_onDriverTick,
+        .arg = this,
+#if TIMER_WHEEL_ISR
+        .dispatch_method = _isr ? ESP_TIMER_ISR : ESP_TIMER_TASK,
+#endif
+        .name = "devlib_tw",
+    };
+    if (esp_timer_create(&timerArgs, &driver) != ESP_OK) {
+        Serial.println("[Err][TimerWheel] Failed to create driver timer");
+        return;
+    }
+#if TIMER_WHEEL_ISR
+    esp_timer_handle_t taskDriver = nullptr;
+    if (_taskDriver == nullptr) {
+        esp_timer_create_args_t taskArgs = {
+            .callback = &_onDeferredTick,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "devlib_tw_task",
+        };
+        if (esp_timer_create(&taskArgs, &taskDriver) != ESP_OK) {
+            Serial.println("[Err][TimerWheel] Failed to create task timer");
+        }
+    }
+#endif
+    TW_ENTER_CRITICAL();
+    // another task may have created them meanwhile
+    if (_driver == nullptr) {
+        _driver = driver;
+        driver = nullptr;
+        if (_running) {
+            // armed from an ISR before the driver existed
+            _running = false;
+            _startDriver(_driverMs);
+        }
+    }
+#if TIMER_WHEEL_ISR
+    if (_taskDriver == nullptr) {
+        _taskDriver = taskDriver;
+        taskDriver = nullptr;
+    }
+#endif
+    TW_EXIT_CRITICAL();
+    if (driver != nullptr) esp_timer_delete(driver);
+#if TIMER_WHEEL_ISR
+    if (taskDriver != nullptr) esp_timer_delete(taskDriver);
+#endif
+#endif
+}
+
+IRAM_ATTR void TimerWheel::_startDriver(uint32_t atMs) {
+    if (_running && (int32_t) (atMs - _driverMs) >= 0) return;
+    // on the millisecond boundary of the tick: micros() and millis() share the clock
+    int32_t delayUs = (int32_t) (atMs * 1000 - (uint32_t) micros());
+    if (delayUs < 0) delayUs = 0;
+#if defined(ESP32)
+    // not created yet: started for this tick by _createDriver()
+    if (_driver != nullptr) {
+        esp_timer_stop(_driver); // no-op unless it waits for a later tick
+        esp_timer_start_once(_driver, delayUs);
+    }
+#elif defined(ESP8266)
+    os_timer_disarm(&_driver);
+    os_timer_setfn(&_driver, _onDriverTick, this);
+    os_timer_arm(&_driver, (delayUs + 999) / 1000, false);
+#endif
+    _running = true;
+    _driverMs = atMs;
+}
+
+IRAM_ATTR void TimerWheel::_stopDriver() {
+    if (!_running) return;
+#if defined(ESP32)
+    if (_driver != nullptr) esp_timer_stop(_driver);
+#elif defined(ESP8266)
+    os_timer_disarm(&_driver);
+#endif
+    _running = false;
+}
+
+TIMER_ISR_ATTR void TimerWheel::_onDriverTick(void *arg) {
+    static_cast<TimerWheel *>(arg)->tick();
+}
+
+void TimerWheel::_onDeferredTick(void *arg) {
+    static_cast<TimerWheel *>(arg)->_runDeferred();
+}
@@ -0,0 +1,205 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <Arduino.h>
+#include "CriticalSection.h"
+
+#if defined(ESP32)
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#elif defined(ESP8266)
+#include <osapi.h>
+#endif
+
+/* Resolution of the library timer in milliseconds */
+#ifndef DEVLIB_TIMER_TICK_MS
+#define DEVLIB_TIMER_TICK_MS 1
+#endif
+
+/*
+ * Define DEVLIB_TIMER_ISR to drive the wheel from the esp_timer ISR (ESP_TIMER_ISR) instead of the
+ * esp_timer task. Needs CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD, not available on ESP8266.
+ */
+#if defined(DEVLIB_TIMER_ISR) && defined(ESP32) && !defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+#warning "DEVLIB_TIMER_ISR needs CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD, the timers stay in the esp_timer task"
+#endif
+
+#if defined(DEVLIB_TIMER_ISR) && !defined(ESP8266) && (!defined(ESP32) || defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD))
+#define TIMER_WHEEL_ISR 1
+#else
+#define TIMER_WHEEL_ISR 0
+#endif
+
+/* Code that may run in the driver ISR: in IRAM when the wheel runs in the ISR */
+#if TIMER_WHEEL_ISR
+#define TIMER_ISR_ATTR IRAM_ATTR
+#else
+#define TIMER_ISR_ATTR
+#endif
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 5
+
+/**
+ * @brief Intrusive timer node. Embed it in the object that owns the timer.
+ *
+ * With ISR dispatch, `isr` (TIMER_ISR_ATTR, no flash, no I2C, no heap) runs in the driver ISR at
+ * expiry and returns true if `callback` is still needed; `callback` then runs in the task. Without
+ * ISR dispatch `isr` is skipped, so `callback` must do the whole work on its own.
+ */
+struct timer_node_t {
+    timer_node_t *next = nullptr;
+    timer_node_t **pprev = nullptr; // nullptr when not armed
+    uint32_t expires = 0;
+    void (*callback)(void *) = nullptr;
+    void *arg = nullptr;
+    bool (*isr)(void *) = nullptr;
+    bool deferred = false; // the isr stage ran, the callback waits in the deferred list
+
+    timer_node_t() = default;
+
+    constexpr timer_node_t(void (*cb)(void *), void *a) : callback(cb), arg(a) {}
+
+    constexpr timer_node_t(void (*cb)(void *), void *a, bool (*isrStage)(void *))
+            : callback(cb), arg(a), isr(isrStage) {}
+
+    timer_node_t(const timer_node_t &) = delete;
+
+    timer_node_t &operator=(const timer_node_t &) = delete;
+};
+
+/**
+ * @brief Hierarchical timer wheel shared by every device of the library.
+ *
+ * One one-shot esp_timer (ESP32) or os_timer (ESP8266) drives all timers. It is started for the next
+ * tick that expires a timer or cascades a slot, never while the wheel is empty, and the ticks in
+ * between are skipped. arm() and cancel() are O(1) and may be called from an ISR.
+ * Callbacks run in the esp_timer task (ESP32) or the SYS context (ESP8266), like the per-device
+ * timers they replace.
+ *
+ * With DEVLIB_TIMER_ISR the driver runs in the esp_timer ISR: the expiry no longer waits behind the
+ * other esp_timer callbacks. The isr stage of a node runs right there, then the node waits in a
+ * deferred list (still armed, cancel() works) until a one-shot esp_timer runs its callback in the
+ * task. setIsrDispatch() switches between both at run time.
+ *
+ * 5 levels of 64 slots cover 2^30 ticks, longer timeouts are cascaded until they fit.
+ *
+ * Constant-initialized: globals of other translation units may arm timers before the static
+ * constructors of this one run. The esp_timer drivers are created by the first arm() outside an ISR.
+ */
+class TimerWheel {
+public:
+    constexpr TimerWheel() = default;
+
+    ~TimerWheel();
+
+    /**
+     * @brief Arm (or re-arm) a timer
+     * @param node
+     * @param ms timeout in milliseconds. 0 fires on the next tick
+     * @return true if the isr stage of the node had already run and its callback is dropped
+     */
+    bool arm(timer_node_t *node, uint32_t ms);
+
+    /**
+     * @brief Cancel a timer, no-op if it is not armed
+     * @param node
+     * @return true if the isr stage of the node had already run and its callback is dropped
+     */
+    bool cancel(timer_node_t *node);
+
+    /**
+     * @brief Check if a timer is armed
+     * @param node
+     */
+    static bool isArmed(const timer_node_t *node) {
+        return node->pprev != nullptr;
+    }
+
+    /**
+     * @brief Number of armed timers
+     */
+    uint32_t count() const {
+        return _count;
+    }
+
+    /**
+     * @brief Advance the wheel to the current time, run expired timers and start the driver for the
+     * next due tick. Called by the driver
+     */
+    void tick();
+
+    /**
+     * @brief Run the isr stages in the driver ISR (default with DEVLIB_TIMER_ISR) or every callback
+     * in the task
+     * @return false if the build has no ISR dispatch (DEVLIB_TIMER_ISR)
+     */
+    bool setIsrDispatch(bool enable);
+
+    bool isIsrDispatch() const {
+        return _isr;
+    }
+
+private:
+    timer_node_t *_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE] = {};
+    uint32_t _now = 0;          // last processed tick
+    uint32_t _lastMs = 0;       // millis() of the last processed tick
+    uint32_t _driverMs = 0;     // millis() the driver is started for
+    uint32_t _count = 0;
+    bool _running = false;      // driver started, false only while the wheel is empty
+    bool _isr = TIMER_WHEEL_ISR;
+    timer_node_t *_deferred = nullptr; // expired in the ISR, callback pending in the task
+    CriticalSection _lock;
+#if defined(ESP32)
+    esp_timer_handle_t _driver = nullptr;
+#if TIMER_WHEEL_ISR
+    esp_timer_handle_t _taskDriver = nullptr; // one-shot, runs the deferred callbacks
+#endif
+#elif defined(ESP8266)
+    os_timer_t _driver = {};
+#endif
+
+    void _insert(timer_node_t *node);
+
+    static void _push(timer_node_t **head, timer_node_t *node);
+
+    static void _unlink(timer_node_t *node);
+
+    void _cascade(uint8_t level);
+
+    void _advance();
+
+    /**
+     * @brief Ticks from the last processed tick to the next one that expires a node or cascades a slot
+     * @return 0 if the wheel is empty
+     */
+    uint32_t _nextDue() const;
+
+    /**
+     * @brief Start the driver for a tick, unless it is already started for an earlier one
+     * @param atMs millis() of the tick
+     */
+    void _startDriver(uint32_t atMs);
+
+    void _stopDriver();
+
+    /**
+     * @brief Create the esp_timer drivers that do not exist yet, task context. A driver armed before
+     * it existed is started
+     */
+    void _createDriver();
+
+    /**
+     * @brief Run the callbacks of the deferred list, task context
+     */
+    void _runDeferred();
+
+    static void _onDriverTick(void *arg);
+
+    static void _onDeferredTick(void *arg);
+};
+
+
+#endif //TIMERWHEEL_H
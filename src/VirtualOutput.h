@@ -18,6 +18,7 @@ public:
     VirtualOutput(const String& name, stdGenericOutput::startup_state_t startUpState) : stdGenericOutput::GenericOutput() {
         _startUpState = startUpState;
         _pinKey = "v" + name;
+        _restoreWarmState();
     }
 #endif
 
@@ -26,9 +27,10 @@ public:
      * @param onFunction
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    void setOnFunction(std::function<void()> onFunction, bool schedule = true) {
-        _onFunction.assign(onFunction, schedule);
+    void setOnFunction(devlib_function_t onFunction, bool schedule = true, const char *tag = nullptr) {
+        _onFunction.assign(std::move(onFunction), schedule, tag);
     }
 
     /**
@@ -36,9 +38,10 @@ public:
      * @param offFunction
      * @param schedule if true, the callback will be scheduled to run in the next loop iteration
      *                 if false, the callback will be executed immediately
+     * @param tag name of the registration site in the scheduler stats (static string), e.g. "p13.onPowerOn"
      */
-    void setOffFunction(std::function<void()> offFunction, bool schedule = true) {
-        _offFunction.assign(offFunction, schedule);
+    void setOffFunction(devlib_function_t offFunction, bool schedule = true, const char *tag = nullptr) {
+        _offFunction.assign(std::move(offFunction), schedule, tag);
     }
 
     /**
@@ -65,17 +68,22 @@ private:
     devlib_callback_t _onFunction;
     devlib_callback_t _offFunction;
 
+    void _groupCallbacks(bool state) override {
+        (state ? _onFunction : _offFunction)();
+        GenericOutput::_groupCallbacks(state);
+    }
+
     void _on_function(bool force) override {
         _pState = stdGenericOutput::ON;
         _state = true;
-        _execCallback(_onFunction);
+        _execKeyedCallback(_onFunction, SCHEDULE_KIND_OUTPUT);
         GenericOutput::on(force);
     }
 
     void _off_function(bool force) override {
         _pState = stdGenericOutput::OFF;
         _state = false;
-        _execCallback(_offFunction);
+        _execKeyedCallback(_offFunction, SCHEDULE_KIND_OUTPUT);
         GenericOutput::off(force);
     }
 